@@ -1,68 +1,311 @@
 #include "Command.h"
+#include "RequestParser.h"
+#include "Commandqueue.h"
+#include "../TrainManager/TimeOfDay.h"
 #include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <sstream>
+#include <algorithm>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 
 using namespace std;
 
-bool Command::sendAll(int sock, const std::string& data) {
-    uint32_t length = htonl(data.size()); 
-    if (send(sock, &length, sizeof(length), 0) != sizeof(length)) {
-        perror("Failed to send message length");
-        return false;
-    }
+bool Command::sendAll(uint64_t connection, string data) {
+    return sendFrame(connection, Frame::make(move(data)));
+}
 
-    size_t total = 0;
-    while (total < data.size()) {
-        ssize_t sent = send(sock, data.c_str() + total, data.size() - total, 0);
-        if (sent <= 0) {
-            perror("Send failed");
-            return false;
+bool Command::sendFrame(uint64_t connection, FramePtr frame) {
+    auto box = Outbox::find(connection);
+    if (!box) return false; // Client already gone
+    return box->send(move(frame));
+}
+
+// Queues every frame first, then flushes each outbox once, so a client
+// receiving several frames gets them in a single gather write. A flush
+// never blocks: a subscriber that is not reading keeps its frames queued
+// (and is dropped past its backlog) without holding up the worker.
+template <typename StillSubscribed>
+static void deliver(const vector<pair<uint64_t, FramePtr>>& frames, StillSubscribed stillSubscribed) {
+    unordered_map<uint64_t, shared_ptr<Outbox>> touched;
+    for (const auto& f : frames) {
+        auto it = touched.find(f.first);
+        if (it == touched.end()) {
+            // Skip clients that unsubscribed or left after the update was rendered;
+            // a new client on the same socket has another connection id
+            auto box = stillSubscribed(f.first) ? Outbox::find(f.first) : nullptr;
+            it = touched.emplace(f.first, box).first;
         }
-        total += sent;
+        if (it->second) it->second->enqueue(f.second, true);
+    }
+    for (auto& t : touched) {
+        if (t.second) t.second->flush();
     }
-    return true;
 }
-// The constructor receives the socket and filters
-GetScheduleCommand::GetScheduleCommand(int socket, std::string from, std::string to) 
-    : Command(socket), fromCity(from), toCity(to) {}
+
+// The constructor receives the connection and filters
+GetScheduleCommand::GetScheduleCommand(uint64_t conn, std::string from, std::string to) 
+    : connection(conn), fromCity(move(from)), toCity(move(to)) {}
 
 void GetScheduleCommand::execute(TrainManager& tm) {
     // The worker thread calls this.
     auto res = tm.getSchedule(fromCity, toCity);
     
     // Send response back to the client that generated the command
-    sendAll(clientSocket,res);
+    Command::sendAll(connection, move(res));
 }
 
 void GetDeparturesCommand::execute(TrainManager& tm) {
     auto res = tm.getDeparturesNextHour(station);
-    sendAll(clientSocket,res);
+    Command::sendAll(connection, move(res));
 }
 
 void GetArrivalsCommand::execute(TrainManager& tm) {
     auto res = tm.getArrivalsNextHour(station);
-    sendAll(clientSocket,res);
+    Command::sendAll(connection, move(res));
 }
 
-ReportDelayCommand::ReportDelayCommand(int socket, int id, int d, string est)
-    : Command(socket), trainID(id), delay(d), estimate(move(est)) {}
+ReportDelayCommand::ReportDelayCommand(uint64_t conn, int id, int d, string est)
+    : connection(conn), trainID(id), delay(d), estimate(move(est)) {}
 
 void ReportDelayCommand::execute(TrainManager& tm) {
     tm.updateDelay(trainID, delay, estimate);
     string msg = "OK: Delay updated!\n";
-    sendAll(clientSocket,msg);
+    Command::sendAll(connection, move(msg));
+}
+
+void ReportDelaysCommand::execute(TrainManager& tm) {
+    // Same record parser as INGEST, with ';' between the records
+    replace(records.begin(), records.end(), ';', '\n');
+    DelayIngest ingest(tm);
+    ingest.feed(records.data(), records.size());
+    ingest.finish();
+    if (ingest.stats().records == 0) {
+        sendAll(connection, "Error: Use REPORT_DELAYS <ID> <Min> <Est>; <ID> <Min> <Est>; ...\n");
+        return;
+    }
+    sendAll(connection, "OK: " + ingest.stats().summary() + "\n");
 }
 
 void GetTrainInfoCommand::execute(TrainManager& tm) {
     auto res = tm.getTrainDetails(trainID);
-    sendAll(clientSocket,res);
+    Command::sendAll(connection, move(res));
+}
+
+void ReloadCommand::execute(TrainManager& tm) {
+    uint64_t requester = connection;
+    CommandQueue& q = queue;
+    thread([&tm, &q, requester]() {
+        string res = tm.reloadTimetable();
+        q.push(make_unique<ReloadDoneCommand>(requester, move(res)));
+    }).detach();
+}
+
+void ReloadDoneCommand::execute(TrainManager& tm) {
+    // Dropped if the client disconnected meanwhile (its id is never reused)
+    sendAll(connection, move(result));
+}
+
+void ReplicationStatusCommand::execute(TrainManager& tm) {
+    sendAll(connection, replicator.status());
+}
+
+void UdpStatusCommand::execute(TrainManager& tm) {
+    sendAll(connection, udp.status());
+}
+
+void SubscribeCommand::execute(TrainManager& tm) {
+    if (station.empty()) {
+        registry.subscribeTrain(connection, trainID);
+        sendAll(connection, "OK: Subscribed to train " + to_string(trainID) + ".\n");
+    } else {
+        registry.subscribeStation(connection, station);
+        sendAll(connection, "OK: Subscribed to station " + station + ".\n");
+    }
+}
+
+void PushUpdateCommand::execute(TrainManager& tm) {
+    deliver(messages, [this](uint64_t connection) { return registry.hasClient(connection); });
+}
+
+void SubscribeBoardCommand::execute(TrainManager& tm) {
+    string snapshot;
+    boards.subscribe(connection, station, tm, snapshot);
+    sendAll(connection, move(snapshot));
+}
+
+void BoardRefreshCommand::execute(TrainManager& tm) {
+    vector<pair<uint64_t, FramePtr>> messages;
+    boards.refresh(tm, stations, messages);
+    deliver(messages, [this](uint64_t connection) { return boards.hasClient(connection); });
+}
+
+void MulticastRefreshCommand::execute(TrainManager& tm) {
+    if (full) multicast.publishFull(tm);
+    else multicast.refresh(tm, stations);
+}
+
+void BoardSnapshotCommand::execute(TrainManager& tm) {
+    string snapshot;
+    if (!multicast.snapshot(station, snapshot)) {
+        sendAll(connection, "Error: " + station + " is not published on multicast (--multicast-board).\n");
+        return;
+    }
+    sendAll(connection, move(snapshot));
+}
+
+void SnapshotFdCommand::execute(TrainManager& tm) {
+    size_t size;
+    uint64_t version;
+    auto fd = snapshot.get(tm, size, version);
+    if (!fd) {
+        sendAll(connection, "ERROR: Snapshot unavailable.\n");
+        return;
+    }
+    sendFrame(connection, Frame::withFd("SNAPSHOT " + to_string(size) + " " + to_string(version) + "\n", move(fd)));
+}
+
+// Parses one sub-query of a BATCH; 'error' is set if it is not a read-only query
+static bool parseQuery(const string& text, TimetableQuery& q, string& error) {
+    RequestTokens args(text);
+    Keyword keyword = lookupKeyword(args.next());
+    if (keyword == Keyword::GET_SCHEDULE) {
+        q.kind = TimetableQuery::SCHEDULE;
+        q.from = args.next();
+        q.to = args.next();
+    } else if (keyword == Keyword::GET_DEPARTURES || keyword == Keyword::GET_ARRIVALS) {
+        q.kind = keyword == Keyword::GET_DEPARTURES ? TimetableQuery::DEPARTURES : TimetableQuery::ARRIVALS;
+        q.from = args.next();
+    } else if (keyword == Keyword::GET_TRAIN_INFO) {
+        q.kind = TimetableQuery::TRAIN_INFO;
+        if (!args.nextInt(q.trainID)) {
+            error = "Error: Use GET_TRAIN_INFO <ID>\n";
+            return false;
+        }
+    } else {
+        error = "Error: Only GET_SCHEDULE, GET_DEPARTURES, GET_ARRIVALS and GET_TRAIN_INFO can be batched.\n";
+        return false;
+    }
+    return true;
+}
+
+void BatchCommand::execute(TrainManager& tm) {
+    const size_t MAX_QUERIES = 100;
+
+    vector<string> texts;
+    stringstream ss(queries);
+    string part;
+    while (getline(ss, part, ';')) {
+        size_t start = part.find_first_not_of(" \t\r\n");
+        if (start == string::npos) continue;
+        size_t end = part.find_last_not_of(" \t\r\n");
+        texts.push_back(part.substr(start, end - start + 1));
+    }
+    if (texts.empty() || texts.size() > MAX_QUERIES) {
+        sendAll(connection, "Error: Use BATCH <query>; <query>; ... (1 to " + to_string(MAX_QUERIES) + " queries)\n");
+        return;
+    }
+
+    vector<TimetableQuery> parsed;
+    vector<string> errors(texts.size());
+    for (size_t i = 0; i < texts.size(); ++i) {
+        TimetableQuery q;
+        if (parseQuery(texts[i], q, errors[i])) parsed.push_back(q);
+    }
+    vector<string> results = tm.runQueries(parsed);
+
+    string res = "BATCH: " + to_string(texts.size()) + " results\n";
+    size_t next = 0;
+    for (size_t i = 0; i < texts.size(); ++i) {
+        res += "--- [" + to_string(i + 1) + "] " + texts[i] + " ---\n";
+        res += errors[i].empty() ? results[next++] : errors[i];
+    }
+    sendAll(connection, move(res));
+}
+
+void BinaryRequestCommand::execute(TrainManager& tm) {
+    WireReader r(request.data(), request.size());
+    uint8_t op = r.get8();
+    uint8_t status = BIN_OK;
+    WireWriter w = encoder->writer();
+
+    switch (op) {
+        case BIN_GET_SCHEDULE: {
+            string from = r.getString8();
+            string to = r.getString8();
+            if (!r.ok()) break;
+            vector<ScheduleRow> rows;
+            tm.getScheduleRows(from, to, rows);
+            w.putVarint(rows.size());
+            for (const auto& row : rows) {
+                w.putVarint(row.trainID);
+                w.putZigzag(row.delayMinutes);
+                w.putVarint(encoder->station(row.from));
+                putMinutes(w, row.departure);
+                w.putVarint(encoder->station(row.to));
+                putMinutes(w, row.arrival);
+            }
+            break;
+        }
+        case BIN_GET_DEPARTURES:
+        case BIN_GET_ARRIVALS: {
+            string station = r.getString8();
+            if (!r.ok()) break;
+            vector<StopEvent> rows;
+            int nowMin = tm.getStopEvents(op == BIN_GET_ARRIVALS, station, rows);
+            putMinutes(w, nowMin);
+            w.putVarint(rows.size());
+            for (const auto& row : rows) {
+                w.putVarint(row.trainID);
+                w.putVarint(encoder->station(row.station));
+                putMinutes(w, row.time);
+                w.putZigzag(row.delayMinutes);
+            }
+            break;
+        }
+        case BIN_REPORT_DELAY: {
+            int id = static_cast<int>(r.getVarint());
+            int delay = static_cast<int>(r.getZigzag());
+            string estimate = r.getString8();
+            if (!r.ok()) break;
+            if (readOnly) status = BIN_READ_ONLY;
+            else if (!tm.updateDelay(id, delay, estimate)) status = BIN_NOT_FOUND;
+            break;
+        }
+        case BIN_GET_TRAIN_INFO: {
+            int id = static_cast<int>(r.getVarint());
+            if (!r.ok()) break;
+            Train t;
+            if (!tm.getTrain(id, t)) {
+                status = BIN_NOT_FOUND;
+                break;
+            }
+            w.putVarint(t.trainID);
+            w.putZigzag(t.delayMinutes);
+            w.putString8(t.estimate);
+            w.putVarint(t.route.size());
+            for (const auto& s : t.route) {
+                w.putVarint(encoder->station(s.name));
+                putMinutes(w, timeofday::toMinutes(s.arrivalTime));
+                putMinutes(w, timeofday::toMinutes(s.departureTime));
+            }
+            break;
+        }
+        default:
+            status = BIN_BAD_REQUEST;
+    }
+    // Arguments are all read before any record is written, so errors carry no records
+    if (!r.ok()) status = BIN_BAD_REQUEST;
+
+    sendAll(connection, encoder->finish(op, status));
 }
 
 // Help command implementation
 void HelpCommand::execute(TrainManager& tm) {
-    string helpMsg = 
+    // Built once; every client gets the same frame
+    static const FramePtr helpFrame = Frame::make(
         "=== CFR STATION - COMMAND LIST ===\n"
         "1. GET_SCHEDULE <Departure> <Arrival>\n"
         "   -> Search route (ex: GET_SCHEDULE Iasi Bucharest).\n"
@@ -74,8 +317,30 @@ void HelpCommand::execute(TrainManager& tm) {
         "   -> Complete details about a train (ex: GET_TRAIN_INFO 1).\n"
         "5. REPORT_DELAY <ID> <Min> <Est>\n"
         "   -> Report delay.\n"
-        "6. help / exit\n"
-        "================================\n";
+        "6. RELOAD\n"
+        "   -> Reload the base timetable without restarting (delays are kept).\n"
+        "7. REPLICATION_STATUS\n"
+        "   -> Role of this server, journal sequence and replica lag.\n"
+        "8. SUBSCRIBE_STATION <Station> / SUBSCRIBE_TRAIN <ID>\n"
+        "   -> Get pushed updates when a delay affects them (UNSUBSCRIBE to stop).\n"
+        "9. SUBSCRIBE_BOARD <Station>\n"
+        "   -> Departure board of the station, then only the rows that change.\n"
+        "10. REPORT_DELAYS <ID> <Min> <Est>; ...\n"
+        "   -> Several delays applied at once. INGEST streams them (one per line).\n"
+        "11. BOARD_SNAPSHOT <Station>\n"
+        "   -> Board published on multicast, with its sequence (receiver recovery).\n"
+        "12. SNAPSHOT_FD\n"
+        "   -> (Unix socket only) Descriptor of the whole timetable as XML.\n"
+        "13. UDP_STATUS\n"
+        "   -> Counters of the UDP delay report endpoint.\n"
+        "14. BATCH <query>; <query>; ...\n"
+        "   -> Several GET_* queries in one request and one response.\n"
+        "15. COMPRESS [OFF|STATUS]\n"
+        "   -> Compresses large responses on this connection (for slow links); STATUS shows the totals.\n"
+        "16. BINARY\n"
+        "   -> Switches the connection to the binary protocol (for programs).\n"
+        "17. help / exit\n"
+        "================================\n");
 
-        sendAll(clientSocket,helpMsg);
+    Command::sendFrame(connection, helpFrame);
 }
\ No newline at end of file
@@ -2,60 +2,211 @@
 #include <memory>
 #include <string>
 #include "../TrainManager/TrainManager.h"
+#include "../Replication/Replicator.h"
+#include "../Subscriptions/SubscriptionRegistry.h"
+#include "../Subscriptions/BoardRegistry.h"
+#include "../Subscriptions/BoardMulticast.h"
+#include "../Protocol/BinaryProtocol.h"
+#include "../Ingest/DelayIngest.h"
+#include "../Ingest/UdpIngest.h"
+#include "../Network/SnapshotFile.h"
 
 // Base class for commands
 class Command {
 protected:
-    int clientSocket; // Client socket that sent the command
-    bool sendAll(int sock, const std::string& data);
+    uint64_t connection; // Outbox::connection() of the client that sent the command
 public:
-    Command(int socket) : clientSocket(socket) {}
+    // Sends one length-prefixed frame through the client's outbox
+    static bool sendAll(uint64_t connection, std::string data);
+    static bool sendFrame(uint64_t connection, FramePtr frame);
+    Command(uint64_t conn) : connection(conn) {}
     virtual void execute(TrainManager& tm) = 0;
     virtual ~Command() = default;
 };
 
-class GetScheduleCommand : public Command {
+// The frequent requests are plain value types: the queue stores them inline
+// (see QueuedCommand in Commandqueue.h) and the worker calls execute()
+// directly, with no allocation and no virtual call. The rest derive from
+// Command and travel as unique_ptr.
+class GetScheduleCommand {
 private:
+    uint64_t connection;
     std::string fromCity;
     std::string toCity;
 public:
-    GetScheduleCommand(int socket, std::string from = "", std::string to = "");
-    void execute(TrainManager& tm) override;
+    GetScheduleCommand(uint64_t conn, std::string from = "", std::string to = "");
+    void execute(TrainManager& tm);
 };
 
-class GetDeparturesCommand : public Command {
+class GetDeparturesCommand {
+    uint64_t connection;
     std::string station;
 public:
-    GetDeparturesCommand(int socket, std::string st = "") : Command(socket), station(st) {}
-    void execute(TrainManager& tm) override;
+    GetDeparturesCommand(uint64_t conn, std::string st = "") : connection(conn), station(std::move(st)) {}
+    void execute(TrainManager& tm);
 };
 
-class GetArrivalsCommand : public Command {
+class GetArrivalsCommand {
+    uint64_t connection;
     std::string station;
 public:
-    GetArrivalsCommand(int socket, std::string st = "") : Command(socket), station(st) {}
-    void execute(TrainManager& tm) override;
+    GetArrivalsCommand(uint64_t conn, std::string st = "") : connection(conn), station(std::move(st)) {}
+    void execute(TrainManager& tm);
 };
 
-class ReportDelayCommand : public Command {
+class ReportDelayCommand {
 private:
+    uint64_t connection;
     int trainID, delay;
     std::string estimate;
 
 public:
-    ReportDelayCommand(int socket, int id, int delay, std::string est);
+    ReportDelayCommand(uint64_t conn, int id, int delay, std::string est);
+    void execute(TrainManager& tm);
+};
+
+class GetTrainInfoCommand {
+    uint64_t connection;
+    int trainID;
+public:
+    GetTrainInfoCommand(uint64_t conn, int id) : connection(conn), trainID(id) {}
+    void execute(TrainManager& tm);
+};
+
+class HelpCommand {
+    uint64_t connection;
+public:
+    HelpCommand(uint64_t conn) : connection(conn) {}
+    void execute(TrainManager& tm);
+};
+
+class CommandQueue;
+
+// Rebuilds the base timetable on a background thread so the worker
+// keeps serving queries; the client gets the result when it is done.
+class ReloadCommand : public Command {
+    CommandQueue& queue; // The result comes back through it (ReloadDoneCommand)
+public:
+    ReloadCommand(uint64_t conn, CommandQueue& q) : Command(conn), queue(q) {}
+    void execute(TrainManager& tm) override;
+};
+
+// Result of a RELOAD, for the connection that asked if it is still there
+class ReloadDoneCommand : public Command {
+    std::string result;
+public:
+    ReloadDoneCommand(uint64_t conn, std::string r) : Command(conn), result(std::move(r)) {}
+    void execute(TrainManager& tm) override;
+};
+
+class ReplicationStatusCommand : public Command {
+    Replicator& replicator;
+public:
+    ReplicationStatusCommand(uint64_t conn, Replicator& r) : Command(conn), replicator(r) {}
     void execute(TrainManager& tm) override;
 };
 
-class GetTrainInfoCommand : public Command {
+class UdpStatusCommand : public Command {
+    UdpIngest& udp;
+public:
+    UdpStatusCommand(uint64_t conn, UdpIngest& u) : Command(conn), udp(u) {}
+    void execute(TrainManager& tm) override;
+};
+
+class SubscribeCommand : public Command {
+    SubscriptionRegistry& registry;
+    std::string station; // Empty when following a train
     int trainID;
 public:
-    GetTrainInfoCommand(int socket, int id) : Command(socket), trainID(id) {}
+    SubscribeCommand(uint64_t conn, SubscriptionRegistry& r, std::string st, int id = 0)
+        : Command(conn), registry(r), station(std::move(st)), trainID(id) {}
+    void execute(TrainManager& tm) override;
+};
+
+// Delivers the push frames rendered after a delay update
+class PushUpdateCommand : public Command {
+    SubscriptionRegistry& registry;
+    std::vector<std::pair<uint64_t, FramePtr>> messages; // Connection -> shared frame
+public:
+    PushUpdateCommand(SubscriptionRegistry& r, std::vector<std::pair<uint64_t, FramePtr>> m)
+        : Command(0), registry(r), messages(std::move(m)) {}
+    void execute(TrainManager& tm) override;
+};
+
+class SubscribeBoardCommand : public Command {
+    BoardRegistry& boards;
+    std::string station;
+public:
+    SubscribeBoardCommand(uint64_t conn, BoardRegistry& b, std::string st)
+        : Command(conn), boards(b), station(std::move(st)) {}
+    void execute(TrainManager& tm) override;
+};
+
+// Sends the row diffs of the boards that changed (after a delay or when the minute advances)
+class BoardRefreshCommand : public Command {
+    BoardRegistry& boards;
+    std::vector<std::string> stations; // Empty: every followed board
+public:
+    BoardRefreshCommand(BoardRegistry& b, std::vector<std::string> st)
+        : Command(0), boards(b), stations(std::move(st)) {}
+    void execute(TrainManager& tm) override;
+};
+
+// Publishes the multicast boards: row diffs, or every board in full
+class MulticastRefreshCommand : public Command {
+    BoardMulticast& multicast;
+    std::vector<std::string> stations; // Empty: every published board
+    bool full;
+public:
+    MulticastRefreshCommand(BoardMulticast& m, std::vector<std::string> st, bool f)
+        : Command(0), multicast(m), stations(std::move(st)), full(f) {}
+    void execute(TrainManager& tm) override;
+};
+
+// A published board with its current multicast sequence (receiver recovery)
+class BoardSnapshotCommand : public Command {
+    BoardMulticast& multicast;
+    std::string station;
+public:
+    BoardSnapshotCommand(uint64_t conn, BoardMulticast& m, std::string st)
+        : Command(conn), multicast(m), station(std::move(st)) {}
+    void execute(TrainManager& tm) override;
+};
+
+// Passes the descriptor of the timetable snapshot to a Unix socket client:
+// "SNAPSHOT <Bytes> <Version>", with the descriptor attached
+class SnapshotFdCommand : public Command {
+    SnapshotFile& snapshot;
+public:
+    SnapshotFdCommand(uint64_t conn, SnapshotFile& s) : Command(conn), snapshot(s) {}
+    void execute(TrainManager& tm) override;
+};
+
+// Several delay reports applied together (one lock, one save):
+// REPORT_DELAYS <ID> <Min> <Est>; <ID> <Min> <Est>; ...
+class ReportDelaysCommand : public Command {
+    std::string records;
+public:
+    ReportDelaysCommand(uint64_t conn, std::string r) : Command(conn), records(std::move(r)) {}
+    void execute(TrainManager& tm) override;
+};
+
+// Several read-only queries in one request, answered in one frame:
+// BATCH <query>; <query>; ...
+class BatchCommand : public Command {
+    std::string queries;
+public:
+    BatchCommand(uint64_t conn, std::string q) : Command(conn), queries(std::move(q)) {}
     void execute(TrainManager& tm) override;
 };
 
-class HelpCommand : public Command {
+// One request of a connection in binary mode (see Protocol/BinaryProtocol.h)
+class BinaryRequestCommand : public Command {
+    std::shared_ptr<BinaryEncoder> encoder; // Station dictionary of the connection
+    std::string request;
+    bool readOnly;
 public:
-    HelpCommand(int socket) : Command(socket) {}
+    BinaryRequestCommand(uint64_t conn, std::shared_ptr<BinaryEncoder> enc, std::string req, bool ro)
+        : Command(conn), encoder(std::move(enc)), request(std::move(req)), readOnly(ro) {}
     void execute(TrainManager& tm) override;
 };
\ No newline at end of file
@@ -2,24 +2,52 @@
 
 using namespace std;
 
-void CommandQueue::push(unique_ptr<Command> cmd) {
+void executeCommand(QueuedCommand& cmd, TrainManager& tm) {
+    visit([&tm](auto& c) {
+        if constexpr (is_same_v<decay_t<decltype(c)>, unique_ptr<Command>>) {
+            if (c) c->execute(tm);
+        } else {
+            c.execute(tm);
+        }
+    }, cmd);
+}
+
+CommandQueue::CommandQueue() : slots(INITIAL_SLOTS) {}
+
+void CommandQueue::grow() {
+    // Unwrap the ring into a larger one, oldest first
+    vector<QueuedCommand> larger(slots.size() * 2);
+    for (size_t i = 0; i < count; ++i) {
+        QueuedCommand& slot = slots[(head + i) % slots.size()];
+        larger[i] = move(slot);
+        slot = nullptr;
+    }
+    slots.swap(larger);
+    head = 0;
+}
+
+void CommandQueue::push(QueuedCommand cmd) {
     {
         lock_guard<mutex> lock(mtx);
-        q.push(move(cmd));
+        if (count == slots.size()) grow();
+        slots[(head + count) % slots.size()] = move(cmd);
+        ++count;
     }
     // Notify the worker that a new command has appeared
     cv.notify_one();
 }
 
-unique_ptr<Command> CommandQueue::pop() {
+QueuedCommand CommandQueue::pop() {
     unique_lock<mutex> lock(mtx);
     
     // Wait until the queue is NOT empty
     // The thread "sleeps" here and does not consume resources
-    cv.wait(lock, [&]{ return !q.empty(); });
+    cv.wait(lock, [&]{ return count > 0; });
 
     // Pop the command
-    auto cmd = move(q.front());
-    q.pop();
+    QueuedCommand cmd = move(slots[head]);
+    slots[head] = nullptr; // Empty again: nothing moved-from is left behind
+    head = (head + 1) % slots.size();
+    --count;
     return cmd;
-}
\ No newline at end of file
+}
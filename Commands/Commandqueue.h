@@ -1,21 +1,41 @@
 #pragma once
-#include <queue>
+#include <vector>
+#include <variant>
 #include <mutex>
 #include <condition_variable>
 #include <memory>
 #include "Command.h"
 
+// What the queue holds: one of the frequent requests by value, or any other
+// Command behind a pointer (first, so an empty slot is a null pointer)
+using QueuedCommand = std::variant<std::unique_ptr<Command>,
+                                   GetScheduleCommand, GetDeparturesCommand, GetArrivalsCommand,
+                                   ReportDelayCommand, GetTrainInfoCommand, HelpCommand>;
+
+// Runs a queued command: a direct call for the value types, a virtual one otherwise
+void executeCommand(QueuedCommand& cmd, TrainManager& tm);
+
 class CommandQueue {
 private:
-    std::queue<std::unique_ptr<Command>> q;
+    static const size_t INITIAL_SLOTS = 1024;
+
+    // Ring of reused slots: commands are moved in and out, and the storage
+    // only grows (doubling) when more are waiting than ever before
+    std::vector<QueuedCommand> slots;
+    size_t head = 0;  // Next to pop
+    size_t count = 0;
     std::mutex mtx;
     std::condition_variable cv;
 
+    void grow();
+
 public:
+    CommandQueue();
+
     // Adds a command to the queue (used by Client Threads)
-    void push(std::unique_ptr<Command> cmd);
+    void push(QueuedCommand cmd);
 
     // Extracts a command (used by Worker Thread)
     // This function is BLOCKING: it waits until there is something in the queue
-    std::unique_ptr<Command> pop();
-};
\ No newline at end of file
+    QueuedCommand pop();
+};
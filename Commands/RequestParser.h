@@ -0,0 +1,116 @@
+#pragma once
+#include <string_view>
+#include <charconv>
+#include <cstdint>
+#include <cstddef>
+
+// Text protocol requests, parsed in place: the keyword is looked up in a
+// perfect hash table built at compile time, and the arguments are views
+// into the receive buffer (numbers through std::from_chars). Nothing is
+// allocated until a Command is built from the arguments.
+enum class Keyword : uint8_t {
+    UNKNOWN,
+    GET_SCHEDULE, GET_DEPARTURES, GET_ARRIVALS, GET_TRAIN_INFO,
+    REPORT_DELAY, REPORT_DELAYS, INGEST, RELOAD,
+    SUBSCRIBE_STATION, SUBSCRIBE_TRAIN, SUBSCRIBE_BOARD, BOARD_SNAPSHOT, UNSUBSCRIBE,
+    BATCH, COMPRESS, BINARY, SNAPSHOT_FD,
+    UDP_STATUS, REPLICATION_STATUS, REPLICATE, FEED, HELP,
+    COUNT
+};
+
+// Spelling of each keyword, in enum order
+inline constexpr std::string_view KEYWORD_NAMES[] = {
+    "",
+    "GET_SCHEDULE", "GET_DEPARTURES", "GET_ARRIVALS", "GET_TRAIN_INFO",
+    "REPORT_DELAY", "REPORT_DELAYS", "INGEST", "RELOAD",
+    "SUBSCRIBE_STATION", "SUBSCRIBE_TRAIN", "SUBSCRIBE_BOARD", "BOARD_SNAPSHOT", "UNSUBSCRIBE",
+    "BATCH", "COMPRESS", "BINARY", "SNAPSHOT_FD",
+    "UDP_STATUS", "REPLICATION_STATUS", "REPLICATE", "FEED", "help",
+};
+static_assert(sizeof(KEYWORD_NAMES) / sizeof(KEYWORD_NAMES[0]) == static_cast<size_t>(Keyword::COUNT),
+              "every keyword needs a name");
+
+namespace keyword_table {
+
+static constexpr size_t SLOTS = 64; // Power of two, well above the keyword count
+
+constexpr uint32_t hash(std::string_view s, uint32_t seed) {
+    uint32_t h = seed;
+    for (char c : s) h = (h ^ static_cast<uint8_t>(c)) * 16777619u; // FNV-1a
+    return h;
+}
+
+struct Table {
+    uint32_t seed = 0;
+    Keyword slot[SLOTS] = {};
+};
+
+// Tries FNV seeds until every keyword lands in its own slot
+constexpr Table build() {
+    for (uint32_t seed = 2166136261u;; ++seed) {
+        Table t;
+        t.seed = seed;
+        bool collision = false;
+        for (size_t k = 1; k < static_cast<size_t>(Keyword::COUNT) && !collision; ++k) {
+            Keyword& s = t.slot[hash(KEYWORD_NAMES[k], seed) & (SLOTS - 1)];
+            if (s != Keyword::UNKNOWN) collision = true;
+            else s = static_cast<Keyword>(k);
+        }
+        if (!collision) return t;
+    }
+}
+
+inline constexpr Table TABLE = build();
+
+} // namespace keyword_table
+
+// One hash, one table load and one compare
+constexpr Keyword lookupKeyword(std::string_view word) {
+    using namespace keyword_table;
+    Keyword k = TABLE.slot[hash(word, TABLE.seed) & (SLOTS - 1)];
+    return KEYWORD_NAMES[static_cast<size_t>(k)] == word ? k : Keyword::UNKNOWN;
+}
+
+static_assert(lookupKeyword("GET_TRAIN_INFO") == Keyword::GET_TRAIN_INFO, "keyword table");
+static_assert(lookupKeyword("GET_TRAIN") == Keyword::UNKNOWN, "keyword table");
+
+// Whitespace-separated arguments of a request, like reading a stringstream
+// with >>, but as views into the request
+class RequestTokens {
+private:
+    std::string_view rest;
+
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f'; }
+
+    template <typename T>
+    bool nextNumber(T& value) {
+        std::string_view token = next();
+        auto r = std::from_chars(token.data(), token.data() + token.size(), value);
+        if (token.empty() || r.ec != std::errc() || r.ptr != token.data() + token.size()) {
+            value = 0;
+            return false;
+        }
+        return true;
+    }
+
+public:
+    explicit RequestTokens(std::string_view request) : rest(request) {}
+
+    // The next word, or an empty view at the end
+    std::string_view next() {
+        size_t start = 0;
+        while (start < rest.size() && isSpace(rest[start])) ++start;
+        size_t end = start;
+        while (end < rest.size() && !isSpace(rest[end])) ++end;
+        std::string_view token = rest.substr(start, end - start);
+        rest.remove_prefix(end);
+        return token;
+    }
+
+    // False (and 0) if the next word is missing or not a whole number
+    bool nextInt(int& value) { return nextNumber(value); }
+    bool nextUint64(uint64_t& value) { return nextNumber(value); }
+
+    // Everything not read yet, e.g. the records of REPORT_DELAYS
+    std::string_view remainder() const { return rest; }
+};
@@ -0,0 +1,291 @@
+#include "GtfsImporter.h"
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstring>
+#include <charconv>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// --- CSV TOKENIZER ---
+
+CsvReader::CsvReader(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        // Private writable mapping: pages are only copied if a quoted field needs unescaping
+        void* p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            data = static_cast<char*>(p);
+            size = st.st_size;
+            madvise(data, size, MADV_SEQUENTIAL);
+            // Skip UTF-8 BOM
+            if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) pos = 3;
+        }
+    }
+    close(fd);
+}
+
+CsvReader::~CsvReader() {
+    if (data) munmap(data, size);
+}
+
+bool CsvReader::next() {
+    fields.clear();
+    if (pos >= size) return false;
+
+    while (true) {
+        if (pos < size && data[pos] == '"') {
+            // Quoted field: may contain commas, newlines and "" escapes
+            size_t start = ++pos;
+            size_t out = 0;
+            bool shifted = false;
+            while (pos < size) {
+                char c = data[pos];
+                if (c == '"') {
+                    if (pos + 1 < size && data[pos + 1] == '"') {
+                        if (!shifted) { out = pos; shifted = true; }
+                        data[out++] = '"';
+                        pos += 2;
+                        continue;
+                    }
+                    break;
+                }
+                if (shifted) data[out++] = c;
+                ++pos;
+            }
+            size_t end = shifted ? out : pos;
+            fields.emplace_back(data + start, end - start);
+            if (pos < size) ++pos; // Closing quote
+            while (pos < size && data[pos] != ',' && data[pos] != '\n') ++pos;
+        } else {
+            size_t start = pos;
+            while (pos < size && data[pos] != ',' && data[pos] != '\n') ++pos;
+            size_t end = pos;
+            if (end > start && data[end - 1] == '\r') --end;
+            fields.emplace_back(data + start, end - start);
+        }
+
+        if (pos < size && data[pos] == ',') {
+            ++pos;
+            continue;
+        }
+        if (pos < size) ++pos; // '\n'
+        return true;
+    }
+}
+
+int CsvReader::column(string_view name) const {
+    for (size_t i = 0; i < fields.size(); ++i) {
+        if (fields[i] == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// --- GTFS HELPERS ---
+
+static bool parseInt(string_view text, int& value) {
+    if (text.empty()) return false;
+    auto res = from_chars(text.data(), text.data() + text.size(), value);
+    return res.ec == errc() && res.ptr == text.data() + text.size();
+}
+
+// "HH:MM:SS" (hours may go past 24 on overnight trips) -> minutes of the day, -1 if empty
+static int parseGtfsTime(string_view text) {
+    int h = 0, m = 0;
+    auto res = from_chars(text.data(), text.data() + text.size(), h);
+    if (res.ec != errc() || res.ptr == text.data() + text.size() || *res.ptr != ':') return -1;
+    const char* mEnd = text.data() + text.size();
+    if (from_chars(res.ptr + 1, mEnd, m).ec != errc()) return -1;
+    return (h * 60 + m) % 1440;
+}
+
+static string formatTime(int minutes) {
+    if (minutes < 0) return "-";
+    char buf[6] = { char('0' + minutes / 600), char('0' + minutes / 60 % 10), ':',
+                    char('0' + minutes % 60 / 10), char('0' + minutes % 10), 0 };
+    return buf;
+}
+
+// The text protocol splits on whitespace, so station names use '_' like the XML data
+static string stationName(string_view raw) {
+    string name(raw);
+    replace(name.begin(), name.end(), ' ', '_');
+    return name;
+}
+
+static void reportRate(const char* file, size_t rows, chrono::steady_clock::time_point start) {
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "[GTFS] " << file << ": " << rows << " rows in " << secs << " s ("
+         << (secs > 0 ? static_cast<size_t>(rows / secs) : rows) << " rows/s)\n";
+}
+
+struct StopTime {
+    int sequence;
+    int station;
+    int arrival;
+    int departure;
+};
+
+// --- IMPORTER ---
+
+bool GtfsImporter::import(const string& dir, map<int, Train>& trains, GtfsImportStats& stats) {
+    using namespace chrono;
+    auto importStart = steady_clock::now();
+
+    CsvReader stopsCsv(dir + "/stops.txt");
+    CsvReader tripsCsv(dir + "/trips.txt");
+    CsvReader timesCsv(dir + "/stop_times.txt");
+    if (!stopsCsv.isOpen() || !tripsCsv.isOpen() || !timesCsv.isOpen()) {
+        cerr << "[GTFS Error] Missing stops.txt, trips.txt or stop_times.txt in " << dir << endl;
+        return false;
+    }
+
+    // 1. Stops: stop_id -> station ID (stops sharing a name share the station)
+    auto start = steady_clock::now();
+    unordered_map<string_view, int> stopToStation;
+    unordered_map<string, int> nameToStation;
+    vector<string> stationNames;
+
+    stopsCsv.next();
+    int colStopId = stopsCsv.column("stop_id");
+    int colStopName = stopsCsv.column("stop_name");
+    if (colStopId < 0 || colStopName < 0) {
+        cerr << "[GTFS Error] stops.txt needs stop_id and stop_name columns\n";
+        return false;
+    }
+    size_t minStopCols = max(colStopId, colStopName) + 1;
+    while (stopsCsv.next()) {
+        const auto& row = stopsCsv.row();
+        if (row.size() < minStopCols) continue;
+        string name = stationName(row[colStopName]);
+        auto named = nameToStation.emplace(name, static_cast<int>(stationNames.size()));
+        if (named.second) stationNames.push_back(move(name));
+        stopToStation.emplace(row[colStopId], named.first->second);
+        ++stats.stops;
+    }
+    reportRate("stops.txt", stats.stops, start);
+
+    // 2. Trips: trip_id -> train. The train number comes from trip_short_name,
+    // then trip_id; anything non-numeric or duplicate gets a fresh ID.
+    start = steady_clock::now();
+    unordered_map<string_view, int> tripIndex;
+    vector<int> wantedIDs;
+
+    tripsCsv.next();
+    int colTripId = tripsCsv.column("trip_id");
+    int colShortName = tripsCsv.column("trip_short_name");
+    if (colTripId < 0) {
+        cerr << "[GTFS Error] trips.txt needs a trip_id column\n";
+        return false;
+    }
+    int maxID = 0;
+    while (tripsCsv.next()) {
+        const auto& row = tripsCsv.row();
+        if (row.size() <= static_cast<size_t>(colTripId)) continue;
+        int id = -1;
+        if (!(colShortName >= 0 && static_cast<size_t>(colShortName) < row.size() && parseInt(row[colShortName], id))) {
+            if (!parseInt(row[colTripId], id)) id = -1;
+        }
+        if (tripIndex.emplace(row[colTripId], static_cast<int>(wantedIDs.size())).second) {
+            wantedIDs.push_back(id);
+            maxID = max(maxID, id);
+        }
+        ++stats.trips;
+    }
+    vector<int> trainIDs(wantedIDs.size());
+    unordered_set<int> taken;
+    for (size_t i = 0; i < wantedIDs.size(); ++i) {
+        int id = wantedIDs[i];
+        if (id < 0 || taken.count(id)) id = ++maxID;
+        taken.insert(id);
+        trainIDs[i] = id;
+    }
+    reportRate("trips.txt", stats.trips, start);
+
+    // 3. Stop times: grouped per trip, ordered by stop_sequence
+    start = steady_clock::now();
+    vector<vector<StopTime>> routes(wantedIDs.size());
+
+    timesCsv.next();
+    int colTimeTrip = timesCsv.column("trip_id");
+    int colArr = timesCsv.column("arrival_time");
+    int colDep = timesCsv.column("departure_time");
+    int colTimeStop = timesCsv.column("stop_id");
+    int colSeq = timesCsv.column("stop_sequence");
+    if (colTimeTrip < 0 || colArr < 0 || colDep < 0 || colTimeStop < 0 || colSeq < 0) {
+        cerr << "[GTFS Error] stop_times.txt needs trip_id, arrival_time, departure_time, stop_id and stop_sequence\n";
+        return false;
+    }
+    size_t minTimeCols = max({ colTimeTrip, colArr, colDep, colTimeStop, colSeq }) + 1;
+
+    // Rows of one trip are usually contiguous, so remember the last lookup
+    string_view lastTrip;
+    int lastTripIdx = -1;
+    while (timesCsv.next()) {
+        const auto& row = timesCsv.row();
+        if (row.size() < minTimeCols) continue;
+        ++stats.stopTimes;
+
+        if (lastTripIdx < 0 || row[colTimeTrip] != lastTrip) {
+            auto it = tripIndex.find(row[colTimeTrip]);
+            if (it == tripIndex.end()) continue;
+            lastTrip = row[colTimeTrip];
+            lastTripIdx = it->second;
+        }
+        auto stop = stopToStation.find(row[colTimeStop]);
+        if (stop == stopToStation.end()) continue;
+
+        StopTime st;
+        if (!parseInt(row[colSeq], st.sequence)) continue;
+        st.station = stop->second;
+        st.arrival = parseGtfsTime(row[colArr]);
+        st.departure = parseGtfsTime(row[colDep]);
+        routes[lastTripIdx].push_back(st);
+    }
+    reportRate("stop_times.txt", stats.stopTimes, start);
+
+    // 4. Build the in-memory model
+    for (size_t i = 0; i < routes.size(); ++i) {
+        auto& stops = routes[i];
+        if (stops.size() < 2) continue;
+        if (!is_sorted(stops.begin(), stops.end(),
+                       [](const StopTime& a, const StopTime& b) { return a.sequence < b.sequence; })) {
+            sort(stops.begin(), stops.end(),
+                 [](const StopTime& a, const StopTime& b) { return a.sequence < b.sequence; });
+        }
+
+        Train t;
+        t.trainID = trainIDs[i];
+        t.delayMinutes = 0;
+        t.estimate = "La Timp";
+        t.route.reserve(stops.size());
+        for (size_t k = 0; k < stops.size(); ++k) {
+            const StopTime& st = stops[k];
+            // Intermediate stops may only carry one of the two times
+            int arr = st.arrival >= 0 ? st.arrival : st.departure;
+            int dep = st.departure >= 0 ? st.departure : st.arrival;
+            Station s;
+            s.name = stationNames[st.station];
+            s.arrivalTime = (k == 0) ? "-" : formatTime(arr);
+            s.departureTime = (k == stops.size() - 1) ? "-" : formatTime(dep);
+            t.route.push_back(move(s));
+        }
+        trains[t.trainID] = move(t);
+    }
+
+    stats.seconds = duration<double>(steady_clock::now() - importStart).count();
+    size_t rows = stats.stops + stats.trips + stats.stopTimes;
+    cout << "[GTFS] Imported " << trains.size() << " trains over " << stationNames.size() << " stations: "
+         << rows << " rows in " << stats.seconds << " s ("
+         << (stats.seconds > 0 ? static_cast<size_t>(rows / stats.seconds) : rows) << " rows/s)\n";
+    return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include "../TrainManager/TrainManager.h"
+
+// Splits a memory-mapped CSV file into rows of string_view fields.
+// Fields point straight into the mapping; only quoted fields with
+// escaped quotes ("") are rewritten, in place, in the private mapping.
+class CsvReader {
+private:
+    char* data = nullptr;
+    size_t size = 0;
+    size_t pos = 0;
+    std::vector<std::string_view> fields; // Reused for every row
+
+public:
+    explicit CsvReader(const std::string& path);
+    ~CsvReader();
+    CsvReader(const CsvReader&) = delete;
+    CsvReader& operator=(const CsvReader&) = delete;
+
+    bool isOpen() const { return data != nullptr; }
+
+    // Reads the next row; returns false at end of file
+    bool next();
+    const std::vector<std::string_view>& row() const { return fields; }
+
+    // Column index of a header name (call right after the header row), -1 if missing
+    int column(std::string_view name) const;
+};
+
+struct GtfsImportStats {
+    size_t stops = 0;
+    size_t trips = 0;
+    size_t stopTimes = 0;
+    double seconds = 0;
+};
+
+// Imports a GTFS-like export (stops.txt, trips.txt, stop_times.txt)
+// into the same std::map<int, Train> model that TrainManager serves.
+class GtfsImporter {
+public:
+    bool import(const std::string& dir, std::map<int, Train>& trains, GtfsImportStats& stats);
+};
@@ -0,0 +1,533 @@
+#include "HttpGateway.h"
+#include "JsonWriter.h"
+#include "../TrainManager/TimeOfDay.h"
+#include <iostream>
+#include <thread>
+#include <charconv>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+
+using namespace std;
+
+bool HttpGateway::start(int httpPort) {
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        perror("[HTTP] socket failed");
+        return false;
+    }
+    int opt = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(httpPort);
+    addr.sin_addr.s_addr = INADDR_ANY;
+    if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, SOMAXCONN) < 0) {
+        perror("[HTTP] bind failed");
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd;
+    epoll_event wake{};
+    wake.events = EPOLLIN;
+    wake.data.fd = wakeFd;
+    if (epollFd < 0 || wakeFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev) < 0 ||
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &wake) < 0) {
+        perror("[HTTP] epoll failed");
+        return false;
+    }
+
+    port = httpPort;
+    cout << "[HTTP] Listening on port " << port << endl;
+    thread(&HttpGateway::run, this).detach();
+    return true;
+}
+
+void HttpGateway::run() {
+    epoll_event events[MAX_EVENTS];
+    while (true) {
+        int n = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("[HTTP] epoll_wait failed");
+            return;
+        }
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                acceptClients();
+                continue;
+            }
+            if (fd == wakeFd) {
+                uint64_t count;
+                while (read(wakeFd, &count, sizeof(count)) > 0) {}
+                publishPending();
+                continue;
+            }
+            auto it = connections.find(fd);
+            if (it == connections.end()) continue;
+
+            uint32_t ev = events[i].events;
+            bool alive = !(ev & EPOLLERR);
+            if (alive && (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))) alive = readable(fd, it->second);
+            if (alive && (ev & EPOLLOUT)) alive = writable(fd, it->second);
+            if (!alive) closeConnection(fd);
+        }
+    }
+}
+
+void HttpGateway::acceptClients() {
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) perror("[HTTP] accept failed");
+            if (errno == EINTR) continue;
+            return;
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            continue;
+        }
+        connections[fd] = Connection();
+    }
+}
+
+void HttpGateway::closeConnection(int fd) {
+    auto it = connections.find(fd);
+    if (it != connections.end() && !it->second.stream.empty()) {
+        auto board = streams.find(it->second.stream);
+        board->second.viewers.erase(fd);
+        if (board->second.viewers.empty()) streams.erase(board);
+        --viewerCount;
+    }
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd);
+}
+
+void HttpGateway::queue(Connection& c, Chunk chunk) {
+    c.queued += chunk->size();
+    c.out.push_back(move(chunk));
+}
+
+bool HttpGateway::readable(int fd, Connection& c) {
+    char buffer[16 * 1024];
+    bool peerDone = false;
+    // Stops once a response closes the connection (431, 400): the rest is not
+    // read. Nor is it while MAX_BACKLOG bytes of replies wait for the client.
+    while (!c.closeAfter && c.queued <= MAX_BACKLOG) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            c.in.append(buffer, n);
+            // A stream has nothing more to ask; its input is only read to notice the close
+            if (c.stream.empty()) answerRequests(fd, c);
+            else c.in.clear();
+        } else if (n == 0) {
+            peerDone = true;
+            break;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            return false;
+        }
+    }
+
+    if (!c.stream.empty()) return !peerDone;
+
+    // A client that stopped sending still gets the answers to what it sent
+    if (peerDone) c.closeAfter = true;
+    return writable(fd, c);
+}
+
+void HttpGateway::answerRequests(int fd, Connection& c) {
+    // Pipelined requests are answered in the order they came, until the
+    // replies back up; the rest wait in 'in' for writable()
+    size_t used = 0;
+    while (!c.closeAfter && c.stream.empty() && c.queued <= MAX_BACKLOG) {
+        Request req;
+        long size = parseRequest(c.in, used, req);
+        if (size == 0) {
+            // Unfinished: the header may take MAX_HEADER bytes, then its body
+            if (c.in.size() - used > MAX_HEADER + req.bodySize) respond(c, 431, "{\"error\":\"Request too large\"}", false);
+            break;
+        }
+        if (size < 0) {
+            respond(c, 400, "{\"error\":\"Malformed request\"}", false);
+            break;
+        }
+        used += size;
+        handle(fd, req, c);
+    }
+    c.in.erase(0, used);
+    if (!c.stream.empty()) {
+        c.in.clear();
+        c.in.shrink_to_fit();
+    }
+}
+
+bool HttpGateway::writable(int fd, Connection& c) {
+    while (true) {
+        while (!c.out.empty()) {
+            // Gather write of the queued chunks, without copying shared events
+            iovec iov[MAX_IOV];
+            size_t count = 0;
+            for (auto it = c.out.begin(); it != c.out.end() && count < MAX_IOV; ++it, ++count) {
+                size_t skip = count == 0 ? c.sentOffset : 0;
+                iov[count].iov_base = const_cast<char*>((*it)->data() + skip);
+                iov[count].iov_len = (*it)->size() - skip;
+            }
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+            ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (n <= 0) return false;
+
+            c.queued -= n;
+            size_t left = n;
+            while (left > 0) {
+                size_t rest = c.out.front()->size() - c.sentOffset;
+                if (left < rest) {
+                    c.sentOffset += left;
+                    break;
+                }
+                left -= rest;
+                c.out.pop_front();
+                c.sentOffset = 0;
+            }
+        }
+        if (c.out.empty() && c.closeAfter) return false;
+
+        // Room again: answer the pipelined requests that were left waiting
+        if (c.queued > MAX_BACKLOG || c.closeAfter || c.in.empty() || !c.stream.empty()) break;
+        size_t before = c.queued;
+        answerRequests(fd, c);
+        if (c.queued == before) break;
+    }
+
+    // Wait for room in the socket only while something is left, and stop
+    // reading requests while MAX_BACKLOG bytes of replies are not taken
+    bool want = !c.out.empty();
+    bool paused = c.stream.empty() && c.queued > MAX_BACKLOG;
+    if (want != c.wantWrite || paused != c.paused) {
+        epoll_event ev{};
+        ev.events = (paused ? 0 : EPOLLIN | EPOLLRDHUP) | (want ? EPOLLOUT : 0);
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+        c.wantWrite = want;
+        c.paused = paused;
+    }
+    return true;
+}
+
+static bool headerIs(const string& line, const char* name, string& value) {
+    size_t len = strlen(name);
+    if (line.size() <= len || line[len] != ':' || strncasecmp(line.c_str(), name, len) != 0) return false;
+    size_t start = line.find_first_not_of(" \t", len + 1);
+    value = start == string::npos ? "" : line.substr(start);
+    return true;
+}
+
+long HttpGateway::parseRequest(const string& in, size_t start, Request& req) {
+    size_t end = in.find("\r\n\r\n", start);
+    if (end == string::npos) return 0;
+
+    size_t lineEnd = in.find("\r\n", start);
+    string requestLine = in.substr(start, lineEnd - start);
+    size_t sp1 = requestLine.find(' ');
+    size_t sp2 = requestLine.rfind(' ');
+    if (sp1 == string::npos || sp2 == sp1) return -1;
+    req.method = requestLine.substr(0, sp1);
+    string target = requestLine.substr(sp1 + 1, sp2 - sp1 - 1);
+    string version = requestLine.substr(sp2 + 1);
+    if (version.compare(0, 5, "HTTP/") != 0) return -1;
+
+    size_t q = target.find('?');
+    req.path = target.substr(0, q);
+    req.query = q == string::npos ? "" : target.substr(q + 1);
+    req.keepAlive = version != "HTTP/1.0";
+
+    size_t bodySize = 0;
+    size_t pos = lineEnd + 2;
+    while (pos < end) {
+        size_t next = in.find("\r\n", pos);
+        string line = in.substr(pos, next - pos);
+        pos = next + 2;
+
+        string value;
+        if (headerIs(line, "Connection", value)) {
+            if (strcasecmp(value.c_str(), "close") == 0) req.keepAlive = false;
+            else if (strcasecmp(value.c_str(), "keep-alive") == 0) req.keepAlive = true;
+        } else if (headerIs(line, "Content-Length", value)) {
+            auto r = from_chars(value.data(), value.data() + value.size(), bodySize);
+            if (r.ec != errc()) return -1;
+        } else if (headerIs(line, "Transfer-Encoding", value)) {
+            return -1; // Requests here have no body worth streaming
+        }
+    }
+
+    // A body is skipped, but only once it is all there
+    req.bodySize = bodySize;
+    size_t total = end + 4 + bodySize - start;
+    if (in.size() - start < total) return bodySize > MAX_HEADER ? -1 : 0;
+    return static_cast<long>(total);
+}
+
+static const char* statusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 431: return "Request Header Fields Too Large";
+        default: return "Error";
+    }
+}
+
+void HttpGateway::respond(Connection& c, int status, const string& body, bool keepAlive) {
+    string response = "HTTP/1.1 " + to_string(status) + " " + statusText(status) + "\r\n"
+                      "Content-Type: application/json\r\n"
+                      "Content-Length: " + to_string(body.size()) + "\r\n";
+    if (!keepAlive) {
+        response += "Connection: close\r\n";
+        c.closeAfter = true;
+    }
+    response += "\r\n";
+    response += body;
+    queue(c, make_shared<const string>(move(response)));
+}
+
+static int hexValue(char h) {
+    if (h >= '0' && h <= '9') return h - '0';
+    if (h >= 'a' && h <= 'f') return h - 'a' + 10;
+    if (h >= 'A' && h <= 'F') return h - 'A' + 10;
+    return -1;
+}
+
+// Value of one query parameter, %XX and '+' decoded; empty if absent
+static string queryParam(const string& query, const string& name) {
+    size_t pos = 0;
+    while (pos <= query.size()) {
+        size_t amp = query.find('&', pos);
+        if (amp == string::npos) amp = query.size();
+        size_t eq = query.find('=', pos);
+        if (eq < amp && query.compare(pos, eq - pos, name) == 0 && eq - pos == name.size()) {
+            string value;
+            for (size_t i = eq + 1; i < amp; ++i) {
+                if (query[i] == '+') {
+                    value += ' ';
+                } else if (query[i] == '%' && i + 2 < amp && hexValue(query[i + 1]) >= 0 && hexValue(query[i + 2]) >= 0) {
+                    value += static_cast<char>(hexValue(query[i + 1]) * 16 + hexValue(query[i + 2]));
+                    i += 2;
+                } else {
+                    value += query[i];
+                }
+            }
+            return value;
+        }
+        pos = amp + 1;
+    }
+    return "";
+}
+
+static void timeOrNull(JsonWriter& j, int minutes) {
+    if (minutes < 0) j.null();
+    else j.value(timeofday::toTime(minutes));
+}
+
+static void stationOrNull(JsonWriter& j, const string& station) {
+    if (station.empty()) j.null();
+    else j.value(station);
+}
+
+void HttpGateway::scheduleJson(const string& query, string& body) {
+    string from = queryParam(query, "from");
+    string to = queryParam(query, "to");
+    vector<ScheduleRow> rows;
+    tm.getScheduleRows(from, to, rows);
+
+    JsonWriter j(body);
+    j.beginObject();
+    j.key("from");
+    stationOrNull(j, from);
+    j.key("to");
+    stationOrNull(j, to);
+    j.key("trains").beginArray();
+    for (const auto& r : rows) {
+        j.beginObject().key("id").value(r.trainID).key("from").value(r.from).key("departure");
+        timeOrNull(j, r.departure);
+        j.key("to").value(r.to).key("arrival");
+        timeOrNull(j, r.arrival);
+        j.key("delay").value(r.delayMinutes).endObject();
+    }
+    j.endArray().endObject();
+}
+
+void HttpGateway::stopEventsJson(bool arrivals, const string& station, string& body) {
+    vector<StopEvent> rows;
+    int nowMin = tm.getStopEvents(arrivals, station, rows);
+
+    JsonWriter j(body);
+    j.beginObject().key("station");
+    stationOrNull(j, station);
+    j.key("now").value(timeofday::toTime(nowMin));
+    j.key(arrivals ? "arrivals" : "departures").beginArray();
+    for (const auto& r : rows) {
+        j.beginObject().key("id").value(r.trainID).key("station").value(r.station)
+         .key("time").value(timeofday::toTime(r.time)).key("delay").value(r.delayMinutes).endObject();
+    }
+    j.endArray().endObject();
+}
+
+bool HttpGateway::trainJson(int id, string& body) {
+    Train t;
+    if (!tm.getTrain(id, t)) return false;
+
+    JsonWriter j(body);
+    j.beginObject().key("id").value(t.trainID).key("delay").value(t.delayMinutes)
+     .key("estimate").value(t.estimate).key("route").beginArray();
+    for (const auto& s : t.route) {
+        j.beginObject().key("station").value(s.name).key("arrival");
+        timeOrNull(j, timeofday::toMinutes(s.arrivalTime));
+        j.key("departure");
+        timeOrNull(j, timeofday::toMinutes(s.departureTime));
+        j.endObject();
+    }
+    j.endArray().endObject();
+    return true;
+}
+
+void HttpGateway::handle(int fd, const Request& req, Connection& c) {
+    if (req.method != "GET") {
+        respond(c, 405, "{\"error\":\"Only GET is supported\"}", req.keepAlive);
+        return;
+    }
+
+    string body;
+    if (req.path == "/schedule") {
+        scheduleJson(req.query, body);
+    } else if (req.path == "/departures" || req.path == "/arrivals") {
+        stopEventsJson(req.path == "/arrivals", queryParam(req.query, "station"), body);
+    } else if (req.path == "/departures/stream") {
+        string station = queryParam(req.query, "station");
+        if (station.empty()) {
+            respond(c, 400, "{\"error\":\"Use /departures/stream?station=<Station>\"}", req.keepAlive);
+            return;
+        }
+        openStream(fd, c, station);
+        return;
+    } else if (req.path.compare(0, 8, "/trains/") == 0) {
+        const char* first = req.path.data() + 8;
+        const char* last = req.path.data() + req.path.size();
+        int id = 0;
+        auto r = from_chars(first, last, id);
+        if (r.ec != errc() || r.ptr != last || first == last) {
+            respond(c, 400, "{\"error\":\"Use /trains/<ID>\"}", req.keepAlive);
+            return;
+        }
+        if (!trainJson(id, body)) {
+            respond(c, 404, "{\"error\":\"Train " + to_string(id) + " not found\"}", req.keepAlive);
+            return;
+        }
+    } else {
+        respond(c, 404, "{\"error\":\"Unknown path; use /schedule, /departures, /arrivals, /trains/<ID> or /departures/stream\"}", req.keepAlive);
+        return;
+    }
+    respond(c, 200, body, req.keepAlive);
+}
+
+HttpGateway::Chunk HttpGateway::renderEvent(const string& station) {
+    // One line of JSON: the data field must not contain a newline
+    string event = "event: board\ndata: ";
+    stopEventsJson(false, station, event);
+    event += "\n\n";
+    return make_shared<const string>(move(event));
+}
+
+void HttpGateway::openStream(int fd, Connection& c, const string& station) {
+    queue(c, make_shared<const string>("HTTP/1.1 200 OK\r\n"
+                                       "Content-Type: text/event-stream\r\n"
+                                       "Cache-Control: no-cache\r\n"
+                                       "\r\n"
+                                       "retry: 2000\n\n"));
+    StreamBoard& board = streams[station];
+    if (!board.last) board.last = renderEvent(station);
+    queue(c, board.last);
+    board.viewers.insert(fd);
+    c.stream = station;
+    ++viewerCount;
+}
+
+void HttpGateway::wakeLoop() {
+    uint64_t one = 1;
+    ssize_t n = write(wakeFd, &one, sizeof(one));
+    (void)n; // Can only fail if the loop is already due to wake up
+}
+
+void HttpGateway::trainChanged(const Train& t) {
+    if (viewerCount == 0) return;
+    {
+        lock_guard<mutex> lock(pendingMtx);
+        for (const auto& s : t.route) pending.insert(s.name);
+    }
+    wakeLoop();
+}
+
+void HttpGateway::minuteChanged() {
+    if (viewerCount == 0) return;
+    {
+        lock_guard<mutex> lock(pendingMtx);
+        pendingAll = true;
+    }
+    wakeLoop();
+}
+
+void HttpGateway::publishPending() {
+    unordered_set<string> stations;
+    bool all;
+    {
+        lock_guard<mutex> lock(pendingMtx);
+        stations.swap(pending);
+        all = pendingAll;
+        pendingAll = false;
+    }
+
+    vector<int> dropped;
+    for (auto& entry : streams) {
+        if (!all && !stations.count(entry.first)) continue;
+        StreamBoard& board = entry.second;
+        board.last = renderEvent(entry.first);
+
+        for (int fd : board.viewers) {
+            Connection& c = connections[fd];
+            // The browser reconnects and starts from a fresh board
+            if (c.queued > MAX_BACKLOG) {
+                dropped.push_back(fd);
+                continue;
+            }
+            queue(c, board.last);
+            if (!writable(fd, c)) dropped.push_back(fd);
+        }
+    }
+    for (int fd : dropped) closeConnection(fd);
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include "../TrainManager/TrainManager.h"
+
+// HTTP/1.1 front end for web clients (--http-port), answering in JSON:
+//
+//   GET /schedule?from=<Station>&to=<Station>
+//   GET /departures[?station=<Station>]
+//   GET /arrivals[?station=<Station>]
+//   GET /trains/<ID>
+//   GET /departures/stream?station=<Station>    (Server-Sent Events)
+//
+// One thread runs an epoll loop over non-blocking sockets, so idle
+// keep-alive connections cost a buffer and no thread. Pipelined requests
+// are answered in order; the responses to everything that arrived in one
+// read go out together. Queries go straight to the TrainManager, and the
+// results are serialized with JsonWriter into the connection's buffer.
+//
+// A stream connection gets the /departures JSON of its station as a "board"
+// event at once, then again whenever a delay touches the station or the
+// minute advances. Each event is rendered once per station and the same
+// buffer is queued on every viewer.
+class HttpGateway {
+private:
+    static const size_t MAX_HEADER = 16 * 1024; // Per request; larger ones get 431
+    static const int MAX_EVENTS = 64;
+    static const size_t MAX_IOV = 64;              // Buffers per sendmsg()
+    static const size_t MAX_BACKLOG = 256 * 1024;  // A viewer this far behind is dropped; a
+                                                   // client this far behind is not read from
+
+    using Chunk = std::shared_ptr<const std::string>;
+
+    struct Connection {
+        std::string in;           // Received, not yet parsed
+        std::deque<Chunk> out;    // Not yet written; responses, or events shared with other viewers
+        size_t sentOffset = 0;    // Bytes of out.front() already written
+        size_t queued = 0;        // Bytes in 'out'
+        bool closeAfter = false;
+        bool wantWrite = false;   // Registered for EPOLLOUT
+        bool paused = false;      // Not registered for EPOLLIN: too many replies not read yet
+        std::string stream;       // Station of an event stream, empty for requests
+    };
+
+    struct StreamBoard {
+        std::unordered_set<int> viewers;
+        Chunk last;               // Current event, sent to new viewers as is
+    };
+
+    struct Request {
+        std::string method;
+        std::string path;
+        std::string query;
+        bool keepAlive = true;
+        size_t bodySize = 0;      // Content-Length, known once the header is complete
+    };
+
+    TrainManager& tm;
+    int listenFd = -1;
+    int epollFd = -1;
+    int port = 0;
+    std::unordered_map<int, Connection> connections;
+    std::unordered_map<std::string, StreamBoard> streams; // By station
+
+    // Stations to re-render, set by other threads; the loop is woken through wakeFd
+    int wakeFd = -1;
+    std::mutex pendingMtx;
+    std::unordered_set<std::string> pending;
+    bool pendingAll = false;
+    std::atomic<size_t> viewerCount{0};
+
+    void run();
+    void acceptClients();
+    // Reads what is there and answers every complete request, one read at a
+    // time, so an unfinished request never holds more than its limit
+    bool readable(int fd, Connection& c);
+    void answerRequests(int fd, Connection& c);
+    // Writes as much of 'out' as the socket takes, answering the requests
+    // left waiting while the replies were backed up; false once the connection is done
+    bool writable(int fd, Connection& c);
+    void closeConnection(int fd);
+    void queue(Connection& c, Chunk chunk);
+
+    // Turns the connection into an event stream of the station's board
+    void openStream(int fd, Connection& c, const std::string& station);
+    Chunk renderEvent(const std::string& station);
+    // Renders the changed boards and queues the event on their viewers
+    void publishPending();
+    void wakeLoop();
+
+    // Parses the request starting at 'start'; 0 if incomplete, -1 if malformed,
+    // otherwise the number of bytes it used
+    static long parseRequest(const std::string& in, size_t start, Request& req);
+    void handle(int fd, const Request& req, Connection& c);
+    void respond(Connection& c, int status, const std::string& body, bool keepAlive);
+
+    // JSON bodies of the routes
+    void scheduleJson(const std::string& query, std::string& body);
+    void stopEventsJson(bool arrivals, const std::string& station, std::string& body);
+    bool trainJson(int id, std::string& body);
+
+public:
+    explicit HttpGateway(TrainManager& manager) : tm(manager) {}
+
+    // Binds the port and starts the event loop thread
+    bool start(int httpPort);
+
+    // Called from other threads: a delay touched these trains' stations, or
+    // the minute advanced (every stream). Cheap when no one is watching.
+    void trainChanged(const Train& t);
+    void minuteChanged();
+};
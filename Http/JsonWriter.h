@@ -0,0 +1,69 @@
+#pragma once
+#include <string>
+#include <cstdio>
+
+// Writes JSON straight into a buffer as the values are produced (no
+// document tree). Commas are placed automatically:
+//
+//   JsonWriter j(out);
+//   j.beginObject().key("id").value(1661).key("route").beginArray() ... ;
+class JsonWriter {
+private:
+    std::string& out;
+    bool needComma = false;
+
+    void separate() {
+        if (needComma) out.push_back(',');
+        needComma = false;
+    }
+
+public:
+    explicit JsonWriter(std::string& buffer) : out(buffer) {}
+
+    JsonWriter& beginObject() { separate(); out.push_back('{'); return *this; }
+    JsonWriter& endObject() { out.push_back('}'); needComma = true; return *this; }
+    JsonWriter& beginArray() { separate(); out.push_back('['); return *this; }
+    JsonWriter& endArray() { out.push_back(']'); needComma = true; return *this; }
+
+    JsonWriter& key(const char* name) {
+        separate();
+        out.push_back('"');
+        out.append(name);
+        out.append("\":");
+        return *this;
+    }
+
+    JsonWriter& value(const std::string& s) {
+        separate();
+        out.push_back('"');
+        for (unsigned char c : s) {
+            if (c == '"' || c == '\\') {
+                out.push_back('\\');
+                out.push_back(static_cast<char>(c));
+            } else if (c < 0x20) {
+                char esc[8];
+                snprintf(esc, sizeof(esc), "\\u%04x", c);
+                out.append(esc);
+            } else {
+                out.push_back(static_cast<char>(c));
+            }
+        }
+        out.push_back('"');
+        needComma = true;
+        return *this;
+    }
+
+    JsonWriter& value(int v) {
+        separate();
+        out.append(std::to_string(v));
+        needComma = true;
+        return *this;
+    }
+
+    JsonWriter& null() {
+        separate();
+        out.append("null");
+        needComma = true;
+        return *this;
+    }
+};
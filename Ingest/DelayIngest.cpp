@@ -0,0 +1,119 @@
+#include "DelayIngest.h"
+#include <cstdio>
+#include <sstream>
+#include <chrono>
+#include <charconv>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+string IngestStats::summary() const {
+    stringstream ss;
+    ss << records << " records in " << batches << " batches, " << applied << " applied, "
+       << (records - applied) << " unknown trains, " << rejected << " malformed; apply latency avg "
+       << (batches ? totalMs / batches : 0) << " ms, max " << maxMs << " ms";
+    return ss.str();
+}
+
+static string_view trim(string_view s) {
+    size_t start = s.find_first_not_of(" \t\r");
+    if (start == string_view::npos) return {};
+    size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(start, end - start + 1);
+}
+
+bool DelayIngest::parseRecord(string_view line, DelayEvent& out) {
+    line = trim(line);
+    char sep = line.find(',') != string_view::npos ? ',' : ' ';
+
+    size_t a = line.find(sep);
+    if (a == string_view::npos) return false;
+    size_t b = line.find(sep, a + 1);
+    if (b == string_view::npos) return false;
+
+    string_view id = trim(line.substr(0, a));
+    string_view delay = trim(line.substr(a + 1, b - a - 1));
+    auto r1 = from_chars(id.data(), id.data() + id.size(), out.trainID);
+    auto r2 = from_chars(delay.data(), delay.data() + delay.size(), out.delayMinutes);
+    if (r1.ec != errc() || r1.ptr != id.data() + id.size()) return false;
+    if (r2.ec != errc() || r2.ptr != delay.data() + delay.size()) return false;
+
+    out.estimate = string(trim(line.substr(b + 1)));
+    return !out.estimate.empty();
+}
+
+void DelayIngest::feed(const char* data, size_t size) {
+    string_view chunk(data, size);
+    size_t start = 0;
+    while (true) {
+        size_t nl = chunk.find('\n', start);
+        if (nl == string_view::npos) break;
+
+        string_view line = chunk.substr(start, nl - start);
+        if (!partial.empty()) {
+            partial.append(line);
+            line = partial;
+        }
+        string_view content = trim(line);
+        if (!content.empty() && content[0] != '#') {
+            DelayEvent e{};
+            if (parseRecord(content, e)) {
+                if (pending.empty()) firstPending = chrono::steady_clock::now();
+                pending.push_back(move(e));
+                if (pending.size() >= MAX_BATCH) flush();
+            } else {
+                ++totals.rejected;
+            }
+        }
+        partial.clear();
+        start = nl + 1;
+    }
+    partial.append(chunk.substr(start));
+}
+
+void DelayIngest::flush() {
+    if (pending.empty()) return;
+
+    auto start = chrono::steady_clock::now();
+    size_t applied = tm.updateDelays(pending);
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    totals.records += pending.size();
+    totals.applied += applied;
+    totals.batches++;
+    totals.totalMs += ms;
+    if (ms > totals.maxMs) totals.maxMs = ms;
+    pending.clear();
+}
+
+void DelayIngest::flushIfDue() {
+    if (msUntilDue() == 0) flush();
+}
+
+int DelayIngest::msUntilDue() const {
+    if (pending.empty()) return -1;
+    auto waited = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - firstPending).count();
+    return waited >= MAX_WAIT_MS ? 0 : static_cast<int>(MAX_WAIT_MS - waited);
+}
+
+void DelayIngest::finish() {
+    if (!partial.empty()) feed("\n", 1);
+    flush();
+}
+
+bool DelayIngest::ingestFile(TrainManager& tm, const string& path, IngestStats& stats) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        perror("[Ingest] open failed");
+        return false;
+    }
+    DelayIngest ingest(tm);
+    vector<char> buffer(256 * 1024);
+    ssize_t n;
+    while ((n = read(fd, buffer.data(), buffer.size())) > 0) ingest.feed(buffer.data(), n);
+    close(fd);
+    ingest.finish();
+    stats = ingest.stats();
+    return true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include "../TrainManager/TrainManager.h"
+
+struct IngestStats {
+    size_t records = 0;   // Well-formed records
+    size_t applied = 0;   // Records for a known train
+    size_t rejected = 0;  // Malformed lines
+    size_t batches = 0;
+    double totalMs = 0;   // Time spent applying (lock, apply, save)
+    double maxMs = 0;
+
+    std::string summary() const;
+};
+
+// Applies newline-delimited delay records in batches. Each record is
+//   <ID>,<Min>,<Estimate>    (or the REPORT_DELAY form: <ID> <Min> <Estimate>)
+// Empty lines and lines starting with '#' are skipped. Every batch goes
+// through TrainManager::updateDelays: one lock (readers never see half a
+// batch) and one save.
+class DelayIngest {
+private:
+    TrainManager& tm;
+    std::string partial;              // Incomplete last line of the previous chunk
+    std::vector<DelayEvent> pending;
+    std::chrono::steady_clock::time_point firstPending; // Arrival of pending[0]
+    IngestStats totals;
+
+public:
+    static const size_t MAX_BATCH = 4096;
+    static const int MAX_WAIT_MS = 100; // Longest a record waits for its batch
+
+    explicit DelayIngest(TrainManager& manager) : tm(manager) {}
+
+    static bool parseRecord(std::string_view line, DelayEvent& out);
+
+    // Takes a chunk of the stream (any split); complete lines are parsed and
+    // applied, a batch at most every MAX_BATCH records
+    void feed(const char* data, size_t size);
+    // Applies what is pending now
+    void flush();
+    // Applies what is pending once its oldest record waited MAX_WAIT_MS, so a
+    // busy stream is applied (and saved) a few times per second, not per chunk
+    void flushIfDue();
+    // Milliseconds until flushIfDue() would apply, -1 if nothing is pending
+    int msUntilDue() const;
+    // End of stream: the last line may lack its newline
+    void finish();
+
+    const IngestStats& stats() const { return totals; }
+
+    // Streams a whole file; false if it cannot be opened
+    static bool ingestFile(TrainManager& tm, const std::string& path, IngestStats& stats);
+};
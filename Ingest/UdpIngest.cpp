@@ -0,0 +1,165 @@
+#include "UdpIngest.h"
+#include "../Protocol/Wire.h"
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+using namespace std;
+
+bool UdpIngest::start(int udpPort) {
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("[UDP] socket failed");
+        return false;
+    }
+    // Room for bursts while a batch is being applied
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(udpPort);
+    addr.sin_addr.s_addr = INADDR_ANY;
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("[UDP] bind failed");
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    port = udpPort;
+    cout << "[UDP] Listening for delay reports on port " << port << endl;
+    thread(&UdpIngest::run, this).detach();
+    return true;
+}
+
+bool UdpIngest::accept(uint64_t device, uint32_t seq, int trainID) {
+    Device& d = devices[device];
+    bool first = d.window == 0;
+    if (!first && seq < d.highest && d.highest - seq >= RESET_JUMP) {
+        // Restarted: its gaps will never be filled, and its old sequences mean nothing now
+        d = Device();
+        first = true;
+        ++counters.resets;
+    }
+
+    if (first || seq > d.highest) {
+        if (!first) {
+            uint32_t gap = seq - d.highest - 1;
+            d.lost += gap;
+            counters.lost += gap;
+            d.window = (seq - d.highest >= 64) ? 0 : d.window << (seq - d.highest);
+        }
+        d.window |= 1;
+        d.highest = seq;
+    } else {
+        uint32_t back = d.highest - seq;
+        if (back >= 64) {
+            ++counters.stale;
+            return false;
+        }
+        if (d.window & (uint64_t(1) << back)) {
+            ++counters.duplicates;
+            return false;
+        }
+        d.window |= uint64_t(1) << back;
+        ++counters.reordered;
+        if (d.lost) {
+            // It was counted as a gap
+            --d.lost;
+            --counters.lost;
+        }
+    }
+
+    // A late report must not undo a newer one about the same train
+    auto it = d.trainSeq.find(trainID);
+    if (it != d.trainSeq.end() && it->second > seq) {
+        ++counters.stale;
+        return false;
+    }
+    d.trainSeq[trainID] = seq;
+    return true;
+}
+
+void UdpIngest::run() {
+    vector<char> buffers(BATCH * MAX_DATAGRAM);
+    mmsghdr msgs[BATCH];
+    iovec iov[BATCH];
+    sockaddr_in sources[BATCH];
+    vector<DelayEvent> updates;
+    updates.reserve(BATCH);
+
+    while (true) {
+        for (int i = 0; i < BATCH; ++i) {
+            iov[i] = { buffers.data() + i * MAX_DATAGRAM, MAX_DATAGRAM };
+            msgs[i] = {};
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &sources[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(sources[i]);
+        }
+        // Blocks for the first datagram, then takes whatever else is queued
+        int n = recvmmsg(fd, msgs, BATCH, MSG_WAITFORONE, nullptr);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("[UDP] recvmmsg failed");
+            return;
+        }
+
+        updates.clear();
+        {
+            lock_guard<mutex> lock(mtx);
+            counters.datagrams += n;
+            counters.batches++;
+            for (int i = 0; i < n; ++i) {
+                WireReader r(buffers.data() + i * MAX_DATAGRAM, msgs[i].msg_len);
+                DelayEvent e{};
+                bool valid = !(msgs[i].msg_hdr.msg_flags & MSG_TRUNC) && r.get8() == 'D';
+                uint32_t deviceID = r.get32();
+                uint32_t seq = r.get32();
+                e.trainID = static_cast<int>(r.getVarint());
+                e.delayMinutes = static_cast<int>(r.getZigzag());
+                e.estimate = r.getString8();
+                if (!valid || !r.ok()) {
+                    ++counters.malformed;
+                    continue;
+                }
+                uint64_t device = uint64_t(ntohl(sources[i].sin_addr.s_addr)) << 32 | deviceID;
+                if (accept(device, seq, e.trainID)) updates.push_back(move(e));
+            }
+        }
+        if (updates.empty()) continue;
+
+        auto start = chrono::steady_clock::now();
+        size_t applied = tm.updateDelays(updates);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        lock_guard<mutex> lock(mtx);
+        counters.applied += applied;
+        if (ms > counters.maxApplyMs) counters.maxApplyMs = ms;
+    }
+}
+
+string UdpIngest::status() const {
+    lock_guard<mutex> lock(mtx);
+    stringstream ss;
+    if (fd < 0) {
+        ss << "UDP ingest: off (start the server with --udp-port <N>)\n";
+        return ss.str();
+    }
+    ss << "UDP ingest on port " << port << ": " << devices.size() << " devices\n"
+       << " datagrams " << counters.datagrams << ", reads " << counters.batches
+       << " (avg " << (counters.batches ? double(counters.datagrams) / counters.batches : 0) << " per read)\n"
+       << " applied " << counters.applied << ", duplicates " << counters.duplicates
+       << ", reordered " << counters.reordered << ", lost " << counters.lost
+       << ", stale " << counters.stale << ", resets " << counters.resets
+       << ", malformed " << counters.malformed << "\n"
+       << " max batch apply " << counters.maxApplyMs << " ms\n";
+    return ss.str();
+}
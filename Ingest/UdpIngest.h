@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+#include "../TrainManager/TrainManager.h"
+
+// Delay reports from track-side devices and onboard units over UDP
+// (--udp-port). One datagram carries one report, big-endian:
+//
+//   'D', deviceID (4 bytes), sequence (4 bytes),
+//   trainID (varint), delay (zigzag varint), estimate (1 byte length + text)
+//
+// Datagrams are read up to 64 at a time (recvmmsg) and every read is applied
+// as one batch. Sequences are tracked per device, identified by its source
+// address and device ID, with a 64-entry window: duplicates are dropped, late
+// datagrams inside the window are still applied unless a newer report from
+// the same device already covered that train. A sequence more than
+// RESET_JUMP below the highest one means the device restarted.
+class UdpIngest {
+private:
+    static const int BATCH = 64;
+    static const size_t MAX_DATAGRAM = 512;
+    static const uint32_t RESET_JUMP = 1024;
+
+    struct Device {
+        uint32_t highest = 0;    // Highest sequence seen
+        uint64_t window = 0;     // Bit i: highest - i was seen
+        uint64_t lost = 0;       // Gaps below 'highest' not filled yet
+        std::unordered_map<int, uint32_t> trainSeq; // Sequence of the last applied report per train
+    };
+
+    struct Counters {
+        uint64_t datagrams = 0;
+        uint64_t batches = 0;     // recvmmsg calls
+        uint64_t applied = 0;
+        uint64_t duplicates = 0;
+        uint64_t reordered = 0;   // Arrived after a higher sequence
+        uint64_t lost = 0;        // Sequence gaps not (yet) filled
+        uint64_t stale = 0;       // Too old for the window, or superseded
+        uint64_t resets = 0;      // Devices that started their sequence over
+        uint64_t malformed = 0;
+        double maxApplyMs = 0;
+    };
+
+    TrainManager& tm;
+    int fd = -1;
+    int port = 0;
+    mutable std::mutex mtx;
+    std::unordered_map<uint64_t, Device> devices; // By IPv4 source address << 32 | device ID
+    Counters counters;
+
+    // Dedupe by (source, device, sequence); true if the report should be applied
+    bool accept(uint64_t device, uint32_t seq, int trainID);
+    void run();
+
+public:
+    explicit UdpIngest(TrainManager& manager) : tm(manager) {}
+
+    // Binds the port and starts the receiving thread
+    bool start(int udpPort);
+    bool running() const { return fd >= 0; }
+
+    // Counters for UDP_STATUS
+    std::string status() const;
+};
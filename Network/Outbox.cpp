@@ -0,0 +1,441 @@
+#include "Outbox.h"
+#include "../Protocol/Lz.h"
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <linux/errqueue.h>
+
+using namespace std;
+
+PassedFd::~PassedFd() {
+    if (fd >= 0) close(fd);
+}
+
+Frame::Frame(string b, bool compressed) : body(move(b)) {
+    uint32_t length = body.size() | (compressed ? COMPRESSED_FLAG : 0);
+    header[0] = length >> 24;
+    header[1] = length >> 16;
+    header[2] = length >> 8;
+    header[3] = length;
+}
+
+static atomic<uint64_t> compressedFrames{0}, compressedIn{0}, compressedOut{0}, compressMicros{0};
+
+FramePtr Frame::compressed(const FramePtr& self) const {
+    call_once(compressOnce, [&]() {
+        auto start = chrono::steady_clock::now();
+        string packed;
+        packed.reserve(body.size() / 2);
+        uint32_t rawSize = body.size();
+        for (int shift = 24; shift >= 0; shift -= 8) packed.push_back(static_cast<char>(rawSize >> shift));
+        lz::compress(body.data(), body.size(), packed);
+
+        compressedFrames.fetch_add(1, memory_order_relaxed);
+        compressedIn.fetch_add(body.size(), memory_order_relaxed);
+        compressedOut.fetch_add(min(packed.size(), body.size()), memory_order_relaxed);
+        compressMicros.fetch_add(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count(),
+                                 memory_order_relaxed);
+        if (packed.size() < body.size()) compressedFrame = make_shared<const Frame>(move(packed), true);
+    });
+    return compressedFrame ? compressedFrame : self;
+}
+
+string Frame::compressionStats() {
+    uint64_t frames = compressedFrames.load(memory_order_relaxed);
+    uint64_t in = compressedIn.load(memory_order_relaxed);
+    uint64_t out = compressedOut.load(memory_order_relaxed);
+    char ratio[16];
+    snprintf(ratio, sizeof(ratio), "%.2f", out ? static_cast<double>(in) / out : 1.0);
+    return to_string(frames) + " frames compressed, " + to_string(in) + " -> " + to_string(out) + " bytes ("
+           + ratio + "x) in " + to_string(compressMicros.load(memory_order_relaxed) / 1000) + " ms";
+}
+
+// --- COMPRESSOR THREAD ---
+
+// Compression runs here so neither the worker thread nor a client thread
+// spends its time on it
+namespace {
+struct CompressJob {
+    shared_ptr<Outbox> box;
+    FramePtr frame;
+};
+
+class Compressor {
+private:
+    mutex mtx;
+    condition_variable cv;
+    deque<CompressJob> jobs;
+
+public:
+    Compressor() { thread(&Compressor::run, this).detach(); }
+
+    void submit(CompressJob job) {
+        {
+            lock_guard<mutex> lock(mtx);
+            jobs.push_back(move(job));
+        }
+        cv.notify_one();
+    }
+
+    void run();
+};
+
+Compressor& compressor() {
+    static Compressor instance;
+    return instance;
+}
+}
+
+// --- SEND POLLER THREAD ---
+
+// Finishes sends that filled a socket buffer once the socket is writable
+// again, so the thread that queued them never waits for a slow reader
+namespace {
+class SendPoller {
+private:
+    int epollFd;
+
+public:
+    SendPoller() : epollFd(epoll_create1(EPOLL_CLOEXEC)) {
+        if (epollFd < 0) perror("epoll_create1");
+        thread(&SendPoller::run, this).detach();
+    }
+
+    // One-shot: a flush that fills the buffer again asks again
+    void watch(int fd, uint64_t connection) {
+        epoll_event ev{};
+        ev.events = EPOLLOUT | EPOLLONESHOT;
+        ev.data.u64 = connection;
+        if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) < 0 && errno == ENOENT) {
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+
+    void run();
+};
+
+SendPoller& sendPoller() {
+    static SendPoller instance;
+    return instance;
+}
+}
+
+Outbox::Outbox(int socket, uint64_t connection) : fd(socket), connectionID(connection) {
+    int one = 1;
+    zeroCopy = setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+}
+
+void Outbox::enqueue(FramePtr frame, bool textPush) {
+    bool toCompress;
+    {
+        lock_guard<mutex> lock(mtx);
+        if (textPush && binary) return;
+        if (broken) return;
+        if (textPush && queuedBytes > MAX_PUSH_BACKLOG) {
+            // The client stopped reading: drop it rather than queue without end.
+            // Its thread sees the shutdown in recv() and cleans up as usual.
+            cerr << "[Outbox] Dropping client " << connectionID << ": " << queuedBytes << " bytes unread" << endl;
+            broken = true;
+            queue.clear();
+            queuedBytes = 0;
+            shutdown(fd, SHUT_RDWR);
+            drained.notify_all();
+            return;
+        }
+        toCompress = compress && frame->size() >= COMPRESS_MIN && !frame->passedFd();
+        queuedBytes += frame->size();
+        queue.push_back({ frame, !toCompress });
+    }
+    if (toCompress) compressor().submit({ shared_from_this(), move(frame) });
+}
+
+void Outbox::setCompression(bool enabled) {
+    lock_guard<mutex> lock(mtx);
+    compress = enabled;
+}
+
+void Outbox::switchToBinary() {
+    lock_guard<mutex> lock(mtx);
+    binary = true;
+}
+
+// Puts the compressed frame in the place of its original and sends what is ready
+void Outbox::compressionDone(const FramePtr& original, FramePtr result) {
+    {
+        lock_guard<mutex> lock(mtx);
+        for (auto& e : queue) {
+            if (!e.ready && e.frame == original) {
+                queuedBytes = queuedBytes - original->size() + result->size();
+                e.frame = move(result);
+                e.ready = true;
+                break;
+            }
+        }
+    }
+    flush();
+}
+
+void Compressor::run() {
+    while (true) {
+        CompressJob job;
+        {
+            unique_lock<mutex> lock(mtx);
+            cv.wait(lock, [this] { return !jobs.empty(); });
+            job = move(jobs.front());
+            jobs.pop_front();
+        }
+        job.box->compressionDone(job.frame, job.frame->compressed(job.frame));
+    }
+}
+
+void SendPoller::run() {
+    epoll_event events[64];
+    while (true) {
+        int n = epoll_wait(epollFd, events, 64, -1);
+        for (int i = 0; i < n; ++i) {
+            // Gone if the client left meanwhile; its socket left the set on close
+            if (auto box = Outbox::find(events[i].data.u64)) box->flush();
+        }
+    }
+}
+
+bool Outbox::send(FramePtr frame) {
+    enqueue(move(frame));
+    return flush();
+}
+
+bool Outbox::flush() {
+    vector<FramePtr> batch;
+    {
+        lock_guard<mutex> lock(mtx);
+        if (broken) {
+            queue.clear();
+            queuedBytes = 0;
+            return false;
+        }
+        if (flushing) return true; // The flushing thread will send it
+        flushing = true;
+    }
+
+    while (true) {
+        size_t offset, total = 0;
+        {
+            lock_guard<mutex> lock(mtx);
+            // Everything up to the first frame still being compressed. Frames
+            // stay queued until they are out, so only this thread pops them.
+            batch.clear();
+            for (auto it = queue.begin(); it != queue.end() && it->ready && batch.size() < MAX_BATCH_FRAMES; ++it) {
+                if (it->frame->passedFd() && !batch.empty()) break; // Starts the next batch
+                batch.push_back(it->frame);
+                total += it->frame->size();
+            }
+            offset = sentOffset;
+            if (batch.empty() || broken) {
+                flushing = false;
+                return !broken;
+            }
+        }
+        ssize_t sent = sendBatch(batch, offset);
+
+        lock_guard<mutex> lock(mtx);
+        if (sent < 0 || broken) { // broken: dropped while we were sending
+            broken = true;
+            queue.clear();
+            queuedBytes = 0;
+            flushing = false;
+            drained.notify_all();
+            return false;
+        }
+        size_t left = sent;
+        queuedBytes -= left;
+        while (left > 0) {
+            size_t rest = queue.front().frame->size() - sentOffset;
+            if (left < rest) {
+                sentOffset += left;
+                break;
+            }
+            left -= rest;
+            sentOffset = 0;
+            queue.pop_front();
+        }
+        drained.notify_all();
+
+        if (static_cast<size_t>(sent) < total - offset) { // Socket buffer full
+            flushing = false;
+            sendPoller().watch(fd, connectionID);
+            return true;
+        }
+    }
+}
+
+// Sends 'batch', skipping the 'offset' bytes of its first frame that went out
+// earlier. Returns the bytes sent before the socket buffer filled, or -1.
+ssize_t Outbox::sendBatch(const vector<FramePtr>& batch, size_t offset) {
+    vector<iovec> iov;
+    iov.reserve(batch.size() * 2);
+    size_t total = 0;
+    for (const auto& f : batch) {
+        iov.push_back({ const_cast<unsigned char*>(f->head()), 4 });
+        if (!f->payload().empty()) iov.push_back({ const_cast<char*>(f->payload().data()), f->payload().size() });
+        total += f->size();
+    }
+
+    bool useZeroCopy = zeroCopy && total - offset >= ZEROCOPY_MIN;
+    bool zeroCopySent = false;
+
+    // Only the first frame of a batch can carry a descriptor, with its first byte
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    const PassedFd* passed = offset == 0 ? batch.front()->passedFd() : nullptr;
+
+    // Skip what went out; a partial write leaves the rest of one iovec
+    size_t first = 0;
+    auto skip = [&](size_t left) {
+        while (first < iov.size() && left >= iov[first].iov_len) left -= iov[first++].iov_len;
+        if (left > 0) {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+            iov[first].iov_len -= left;
+        }
+    };
+    skip(offset);
+
+    size_t done = 0;
+    while (first < iov.size()) {
+        msghdr msg{};
+        msg.msg_iov = iov.data() + first;
+        msg.msg_iovlen = iov.size() - first;
+        if (passed) {
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+            cm->cmsg_level = SOL_SOCKET;
+            cm->cmsg_type = SCM_RIGHTS;
+            cm->cmsg_len = CMSG_LEN(sizeof(int));
+            int fdToPass = passed->get();
+            memcpy(CMSG_DATA(cm), &fdToPass, sizeof(int));
+        }
+
+        // Never blocks: the caller may be the worker thread
+        ssize_t sent = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT | (useZeroCopy ? MSG_ZEROCOPY : 0));
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == ENOBUFS && useZeroCopy) { // Out of option memory: copy this one
+                useZeroCopy = false;
+                continue;
+            }
+            perror("Send failed");
+            return -1;
+        }
+        if (useZeroCopy) {
+            ++nextZeroCopyId;
+            zeroCopySent = true;
+        }
+        passed = nullptr;
+        done += sent;
+        skip(sent);
+    }
+
+    lock_guard<mutex> lock(mtx);
+    if (zeroCopySent) inFlight.emplace_back(nextZeroCopyId - 1, batch);
+    reapCompletions(0);
+    return done;
+}
+
+void Outbox::waitBacklog(size_t bytes) {
+    unique_lock<mutex> lock(mtx);
+    drained.wait(lock, [&] { return broken || queuedBytes <= bytes; });
+}
+
+// Reads MSG_ZEROCOPY completions from the socket error queue and releases the
+// frames the kernel no longer references. Called with the lock held.
+void Outbox::reapCompletions(int timeoutMs) {
+    while (!inFlight.empty()) {
+        if (timeoutMs > 0) {
+            pollfd p{ fd, 0, 0 }; // POLLERR is always reported
+            if (poll(&p, 1, timeoutMs) <= 0 || !(p.revents & POLLERR)) return;
+        }
+
+        char control[128];
+        msghdr msg{};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) return;
+
+        for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            bool recvErr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                        || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+            if (!recvErr) continue;
+            auto* err = reinterpret_cast<sock_extended_err*>(CMSG_DATA(cm));
+            if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+
+            // Completed ids [ee_info, ee_data]; TCP completes them in order
+            uint32_t last = err->ee_data;
+            while (!inFlight.empty() && static_cast<int32_t>(inFlight.front().first - last) <= 0) {
+                inFlight.pop_front();
+            }
+        }
+    }
+}
+
+void Outbox::drain() {
+    // What is still queued, e.g. a reply just before 'exit'. The poller no
+    // longer finds a released outbox, so send it from here.
+    for (int i = 0; i < 10; ++i) {
+        {
+            lock_guard<mutex> lock(mtx);
+            if (broken || queuedBytes == 0) break;
+        }
+        flush();
+        pollfd p{ fd, POLLOUT, 0 };
+        poll(&p, 1, 100);
+    }
+
+    lock_guard<mutex> lock(mtx);
+    for (int i = 0; i < 20 && !inFlight.empty(); ++i) reapCompletions(50);
+    if (!inFlight.empty()) {
+        cerr << "[Outbox] " << inFlight.size() << " zero-copy sends still pending on " << fd << endl;
+    }
+}
+
+// --- CONNECTION TABLE ---
+
+static mutex tableMtx;
+static unordered_map<uint64_t, shared_ptr<Outbox>> outboxes;
+static uint64_t nextConnection = 1;
+
+shared_ptr<Outbox> Outbox::open(int socket) {
+    lock_guard<mutex> lock(tableMtx);
+    auto box = make_shared<Outbox>(socket, nextConnection++);
+    outboxes[box->connection()] = box;
+    return box;
+}
+
+shared_ptr<Outbox> Outbox::find(uint64_t connection) {
+    lock_guard<mutex> lock(tableMtx);
+    auto it = outboxes.find(connection);
+    return it == outboxes.end() ? nullptr : it->second;
+}
+
+void Outbox::release(uint64_t connection) {
+    shared_ptr<Outbox> box;
+    {
+        lock_guard<mutex> lock(tableMtx);
+        auto it = outboxes.find(connection);
+        if (it == outboxes.end()) return;
+        box = move(it->second);
+        outboxes.erase(it);
+    }
+    box->drain();
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <sys/types.h>
+
+class Frame;
+using FramePtr = std::shared_ptr<const Frame>;
+
+// A file descriptor sent along with a frame (SCM_RIGHTS, Unix sockets only).
+// Closed when the last frame referencing it is gone.
+class PassedFd {
+private:
+    int fd;
+
+public:
+    explicit PassedFd(int descriptor) : fd(descriptor) {}
+    ~PassedFd();
+    PassedFd(const PassedFd&) = delete;
+    PassedFd& operator=(const PassedFd&) = delete;
+
+    int get() const { return fd; }
+};
+
+// One length-prefixed response, built once and never modified afterwards,
+// so the same frame can sit in the outboxes of many connections at once.
+//
+// The top bit of the length marks a compressed frame (for connections that
+// sent COMPRESS): its body is the original size (4 bytes) followed by an
+// LZ block (Protocol/Lz.h).
+class Frame {
+private:
+    static const uint32_t COMPRESSED_FLAG = 0x80000000u;
+
+    unsigned char header[4]; // Body length, big-endian
+    std::string body;
+
+    // Compressed once, however many connections want it that way
+    mutable std::once_flag compressOnce;
+    mutable FramePtr compressedFrame;
+
+    std::shared_ptr<const PassedFd> attached;
+
+public:
+    explicit Frame(std::string b, bool compressed = false);
+
+    static FramePtr make(std::string body) {
+        return std::make_shared<const Frame>(std::move(body));
+    }
+
+    // A frame whose first byte carries a descriptor to the receiver, which
+    // must read the frame header with recvmsg()
+    static FramePtr withFd(std::string body, std::shared_ptr<const PassedFd> fd) {
+        auto frame = std::make_shared<Frame>(std::move(body));
+        frame->attached = std::move(fd);
+        return frame;
+    }
+    const PassedFd* passedFd() const { return attached.get(); }
+
+    const unsigned char* head() const { return header; }
+    const std::string& payload() const { return body; }
+    size_t size() const { return sizeof(header) + body.size(); }
+
+    // The compressed version, or the frame itself if compression does not pay.
+    // Thread-safe; the first caller does the work.
+    FramePtr compressed(const FramePtr& self) const;
+
+    // Frames compressed since startup, bytes in and out, time (COMPRESS STATUS)
+    static std::string compressionStats();
+};
+
+// Output queue of one client connection. Frames are only referenced, never
+// copied: a flush hands the headers and bodies of every queued frame to one
+// sendmsg() (gather write). Batches of ZEROCOPY_MIN bytes or more are sent
+// with MSG_ZEROCOPY when the kernel supports it; their frames are kept alive
+// until the kernel reports it is done with the pages.
+//
+// Any thread may send, and sending never blocks. If another thread is
+// already flushing, the frame is left in the queue and goes out with that
+// thread's next batch. What does not fit in the socket buffer stays queued
+// and a poller thread sends it when the socket is writable. A client that
+// lets MAX_PUSH_BACKLOG bytes pile up is dropped at its next push; its own
+// thread calls waitBacklog() before reading another request.
+//
+// With compression on, frames of COMPRESS_MIN bytes or more are handed to a
+// background thread; frames queued after one wait until it is compressed so
+// the order is kept.
+//
+// A frame carrying a descriptor starts a sendmsg() of its own, so the
+// descriptor arrives with that frame's header.
+class Outbox : public std::enable_shared_from_this<Outbox> {
+private:
+    static const size_t ZEROCOPY_MIN = 16 * 1024;
+    static const size_t MAX_BATCH_FRAMES = 512; // Two iovecs per frame, within IOV_MAX
+    static const size_t COMPRESS_MIN = 2048;
+    static const size_t MAX_PUSH_BACKLOG = 16 * 1024 * 1024;
+
+    struct Entry {
+        FramePtr frame;
+        bool ready;    // False while waiting for the compressor
+    };
+
+    int fd;
+    uint64_t connectionID; // Unique for the life of the process, unlike fd
+    std::mutex mtx;
+    std::deque<Entry> queue;
+    size_t sentOffset = 0;  // Bytes of the front frame already sent
+    size_t queuedBytes = 0; // Not yet sent
+    std::condition_variable drained;
+    bool flushing = false;
+    bool broken = false;
+    bool compress = false;
+    bool binary = false; // Speaks the binary protocol (BINARY): no text pushes
+
+    // MSG_ZEROCOPY bookkeeping: each zero-copy sendmsg() gets the next id
+    bool zeroCopy = false;
+    uint32_t nextZeroCopyId = 0;
+    std::deque<std::pair<uint32_t, std::vector<FramePtr>>> inFlight;
+
+    ssize_t sendBatch(const std::vector<FramePtr>& batch, size_t offset);
+    void reapCompletions(int timeoutMs);
+
+public:
+    // Backlog a client thread waits for before it reads the next request
+    static const size_t MAX_BACKLOG = 4 * 1024 * 1024;
+
+    Outbox(int socket, uint64_t connection);
+
+    uint64_t connection() const { return connectionID; }
+
+    // Queues without sending; flush() sends everything queued so far.
+    // A text push (subscriptions, boards) is dropped on a binary connection.
+    void enqueue(FramePtr frame, bool textPush = false);
+    bool flush();
+    bool send(FramePtr frame);
+    // Blocks until at most 'bytes' are left to send or the connection broke
+    void waitBacklog(size_t bytes);
+
+    // Frames sent after this are compressed when large enough
+    void setCompression(bool enabled);
+    // Text pushes queued after this are dropped; those queued before still
+    // precede the reply that confirms the switch
+    void switchToBinary();
+    // Called by the compressor thread: 'result' replaces 'original' in the queue
+    void compressionDone(const FramePtr& original, FramePtr result);
+
+    // Waits (briefly) for queued frames and outstanding zero-copy sends
+    // before the socket is closed
+    void drain();
+
+    // Outboxes of the connected clients, by connection id. A socket number
+    // is reused after close; a connection id never is, so a reply or push
+    // that arrives after its client left finds nothing instead of the
+    // next client on that socket.
+    static std::shared_ptr<Outbox> open(int socket);
+    static std::shared_ptr<Outbox> find(uint64_t connection);
+    static void release(uint64_t connection);
+};
@@ -0,0 +1,43 @@
+#include "SnapshotFile.h"
+#include <iostream>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+shared_ptr<const PassedFd> SnapshotFile::get(TrainManager& tm, size_t& size, uint64_t& version) {
+    lock_guard<mutex> lock(mtx);
+    if (!current || tm.timetableVersion() != currentVersion) {
+        string xml;
+        uint64_t rendered = tm.renderSnapshot(xml);
+
+        int fd = memfd_create("timetable-snapshot", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd < 0) {
+            perror("[Snapshot] memfd_create failed");
+            return nullptr;
+        }
+        size_t written = 0;
+        while (written < xml.size()) {
+            ssize_t n = write(fd, xml.data() + written, xml.size() - written);
+            if (n <= 0) {
+                perror("[Snapshot] write failed");
+                close(fd);
+                return nullptr;
+            }
+            written += n;
+        }
+        // Receivers can trust the content never changes under them
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+
+        // Frames still queued keep the previous file open until they are sent
+        current = make_shared<const PassedFd>(fd);
+        currentVersion = rendered;
+        currentSize = xml.size();
+        cout << "[Snapshot] Rendered version " << rendered << " (" << xml.size() << " bytes)\n";
+    }
+    size = currentSize;
+    version = currentVersion;
+    return current;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include "Outbox.h"
+#include "../TrainManager/TrainManager.h"
+
+// The current timetable (with delays) as schedule XML in a sealed memfd, for
+// SNAPSHOT_FD: local clients get the descriptor itself over the Unix socket
+// instead of the bytes. It is rendered again only after the timetable
+// changed, and every client of one version shares the same file.
+//
+// The file is sealed against writes and resizing. Clients share one file
+// offset, so they should read it with mmap() or pread().
+class SnapshotFile {
+private:
+    std::mutex mtx;
+    std::shared_ptr<const PassedFd> current;
+    uint64_t currentVersion = 0;
+    size_t currentSize = 0;
+
+public:
+    // Descriptor of the current snapshot, or nullptr if it cannot be created
+    std::shared_ptr<const PassedFd> get(TrainManager& tm, size_t& size, uint64_t& version);
+};
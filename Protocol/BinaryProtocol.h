@@ -0,0 +1,117 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "Wire.h"
+
+// Compact binary protocol, negotiated with the text command BINARY.
+// After the "OK" reply, every request and response is a length-prefixed frame:
+//
+//   request:  opcode, arguments
+//   response: opcode | 0x80, status, station dictionary additions, records
+//
+// Stations are referred to by a small ID. Each name is sent once per
+// connection: a response first lists the (ID, name) pairs its records use
+// for the first time (count, count x (ID, name)).
+// Integers are varints (delays zigzag); minute values are sent as minute + 1
+// so that 0 can mean "no time".
+//
+//   GET_SCHEDULE   from, to        -> count x (trainID, delay, fromStation, departure, toStation, arrival)
+//   GET_DEPARTURES station         -> now, count x (trainID, station, time, delay)
+//   GET_ARRIVALS   station         -> now, count x (trainID, station, time, delay)
+//   REPORT_DELAY   trainID, delay, estimate  -> (status only)
+//   GET_TRAIN_INFO trainID         -> trainID, delay, estimate, count x (station, arrival, departure)
+//
+// Station names and estimates are one byte length strings; an empty station
+// means "any".
+enum BinaryOpcode : uint8_t {
+    BIN_GET_SCHEDULE   = 1,
+    BIN_GET_DEPARTURES = 2,
+    BIN_GET_ARRIVALS   = 3,
+    BIN_REPORT_DELAY   = 4,
+    BIN_GET_TRAIN_INFO = 5,
+};
+
+enum BinaryStatus : uint8_t {
+    BIN_OK          = 0,
+    BIN_NOT_FOUND   = 1,
+    BIN_BAD_REQUEST = 2,
+    BIN_READ_ONLY   = 3, // Replica: updates go to the primary
+};
+
+const uint8_t BIN_RESPONSE = 0x80;
+
+inline void putMinutes(WireWriter& w, int minutes) { w.putVarint(minutes < 0 ? 0 : minutes + 1); }
+inline int getMinutes(WireReader& r) { return static_cast<int>(r.getVarint()) - 1; }
+
+// Server side, one per connection: assigns station IDs and remembers which
+// names the client already knows
+class BinaryEncoder {
+private:
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<const std::string*> added; // Names first used by the current response
+    std::string records;
+
+public:
+    // Starts a response; write its records through writer()
+    WireWriter writer() {
+        records.clear();
+        added.clear();
+        return WireWriter(records);
+    }
+
+    uint32_t station(const std::string& name) {
+        auto it = ids.emplace(name, static_cast<uint32_t>(ids.size()));
+        if (it.second) added.push_back(&it.first->first);
+        return it.first->second;
+    }
+
+    // The complete response: header, dictionary additions, then the records
+    std::string finish(uint8_t opcode, uint8_t status) {
+        std::string frame;
+        frame.reserve(records.size() + 16);
+        WireWriter w(frame);
+        w.put8(opcode | BIN_RESPONSE);
+        w.put8(status);
+        w.putVarint(added.size());
+        for (const std::string* name : added) {
+            w.putVarint(ids[*name]);
+            w.putString8(*name);
+        }
+        frame.append(records);
+        return frame;
+    }
+};
+
+// Client side: keeps the station dictionary across responses
+class BinaryDecoder {
+private:
+    std::vector<std::string> names;
+
+public:
+    struct Header {
+        uint8_t opcode;
+        uint8_t status;
+    };
+
+    // Reads the header and the dictionary additions; 'r' is left at the records
+    bool begin(WireReader& r, Header& h) {
+        h.opcode = r.get8() & ~BIN_RESPONSE;
+        h.status = r.get8();
+        uint64_t count = r.getVarint();
+        for (uint64_t i = 0; i < count && r.ok(); ++i) {
+            uint64_t id = r.getVarint();
+            std::string name = r.getString8();
+            if (id > names.size() + count) return false; // IDs are handed out densely
+            if (id >= names.size()) names.resize(id + 1);
+            names[id] = std::move(name);
+        }
+        return r.ok();
+    }
+
+    const std::string& station(uint64_t id) const {
+        static const std::string unknown = "?";
+        return id < names.size() ? names[id] : unknown;
+    }
+};
@@ -0,0 +1,142 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Wire.h"
+
+// One applied delay update, numbered in apply order
+struct DelayEvent {
+    uint64_t seq;
+    int64_t timeMs;      // Wall clock (ms) when it was applied
+    int trainID;
+    int delayMinutes;
+    std::string estimate;
+};
+
+// Compact binary encoding of the change feed (FEED and REPLICATE streams).
+// Each frame travels inside the usual length-prefixed frame:
+//   'S' epoch, head, count, count x (trainID, delay, estimate)      full state
+//   'E' firstSeq, count, count x (timeDeltaMs, trainID, delay, estimate)
+//   'H' head, timeMs                                                heartbeat
+// Integers are varints (delays zigzag). Sequences inside an 'E' frame are
+// contiguous, so only the first is sent. An estimate text is sent once per
+// stream and later referenced by its index in a small dictionary.
+const size_t FEED_DICTIONARY_SIZE = 255;
+
+class FeedEncoder {
+private:
+    std::vector<std::string> estimates;
+
+    void putEstimate(WireWriter& w, const std::string& estimate) {
+        for (size_t i = 0; i < estimates.size(); ++i) {
+            if (estimates[i] == estimate) {
+                w.putVarint(i + 1);
+                return;
+            }
+        }
+        w.putVarint(0);
+        w.putString(estimate);
+        if (estimates.size() < FEED_DICTIONARY_SIZE) estimates.push_back(estimate);
+    }
+
+public:
+    void snapshot(std::string& frame, uint64_t epoch, uint64_t head, const std::vector<DelayEvent>& state) {
+        WireWriter w(frame);
+        w.put8('S');
+        w.putVarint(epoch);
+        w.putVarint(head);
+        w.putVarint(state.size());
+        for (const auto& e : state) {
+            w.putVarint(static_cast<uint32_t>(e.trainID));
+            w.putZigzag(e.delayMinutes);
+            putEstimate(w, e.estimate);
+        }
+    }
+
+    // 'events' must hold contiguous sequences
+    void changes(std::string& frame, const std::vector<DelayEvent>& events) {
+        WireWriter w(frame);
+        w.put8('E');
+        w.putVarint(events.empty() ? 0 : events.front().seq);
+        w.putVarint(events.size());
+        int64_t prevTime = 0;
+        for (const auto& e : events) {
+            w.putZigzag(e.timeMs - prevTime);
+            prevTime = e.timeMs;
+            w.putVarint(static_cast<uint32_t>(e.trainID));
+            w.putZigzag(e.delayMinutes);
+            putEstimate(w, e.estimate);
+        }
+    }
+
+    void heartbeat(std::string& frame, uint64_t head, int64_t timeMs) {
+        WireWriter w(frame);
+        w.put8('H');
+        w.putVarint(head);
+        w.putVarint(static_cast<uint64_t>(timeMs));
+    }
+};
+
+class FeedDecoder {
+private:
+    std::vector<std::string> estimates;
+
+    std::string getEstimate(WireReader& r) {
+        uint64_t idx = r.getVarint();
+        if (idx == 0) {
+            std::string s = r.getString();
+            if (estimates.size() < FEED_DICTIONARY_SIZE) estimates.push_back(s);
+            return s;
+        }
+        if (idx > estimates.size()) return "";
+        return estimates[idx - 1];
+    }
+
+public:
+    struct Frame {
+        char type = 0;
+        uint64_t epoch = 0;
+        uint64_t head = 0;     // 'S' and 'H'
+        int64_t timeMs = 0;    // 'H'
+        std::vector<DelayEvent> events;
+    };
+
+    bool decode(const std::string& data, Frame& out) {
+        WireReader r(data.data(), data.size());
+        out.events.clear();
+        out.type = static_cast<char>(r.get8());
+
+        if (out.type == 'S') {
+            out.epoch = r.getVarint();
+            out.head = r.getVarint();
+            uint64_t count = r.getVarint();
+            for (uint64_t i = 0; i < count && r.ok(); ++i) {
+                DelayEvent e{};
+                e.trainID = static_cast<int>(r.getVarint());
+                e.delayMinutes = static_cast<int>(r.getZigzag());
+                e.estimate = getEstimate(r);
+                out.events.push_back(std::move(e));
+            }
+        } else if (out.type == 'E') {
+            uint64_t seq = r.getVarint();
+            uint64_t count = r.getVarint();
+            int64_t time = 0;
+            for (uint64_t i = 0; i < count && r.ok(); ++i) {
+                DelayEvent e;
+                e.seq = seq++;
+                time += r.getZigzag();
+                e.timeMs = time;
+                e.trainID = static_cast<int>(r.getVarint());
+                e.delayMinutes = static_cast<int>(r.getZigzag());
+                e.estimate = getEstimate(r);
+                out.events.push_back(std::move(e));
+            }
+        } else if (out.type == 'H') {
+            out.head = r.getVarint();
+            out.timeMs = static_cast<int64_t>(r.getVarint());
+        } else {
+            return false;
+        }
+        return r.ok();
+    }
+};
@@ -0,0 +1,121 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+// Small LZ77 block codec (LZ4-style sequences), header-only so the client can
+// decompress. Good at the repetitive text we send: station names, "[On Time]".
+//
+// A block is a list of sequences:
+//   token       high 4 bits: literal count, low 4 bits: match length - 4
+//               (15 means "more": add bytes until one is below 255)
+//   literals
+//   offset      2 bytes, little-endian, distance back to the match
+// The last sequence only has literals.
+namespace lz {
+
+const size_t MIN_MATCH = 4;
+const size_t HASH_BITS = 14;
+const size_t MAX_OFFSET = 65535;
+const size_t LAST_LITERALS = 5; // The block always ends with literals
+
+inline uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t hash4(uint32_t v) {
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+inline void putLength(std::string& out, size_t len) {
+    while (len >= 255) {
+        out.push_back(static_cast<char>(255));
+        len -= 255;
+    }
+    out.push_back(static_cast<char>(len));
+}
+
+inline void putSequence(std::string& out, const unsigned char* lit, size_t litLen, size_t offset, size_t matchLen) {
+    size_t m = matchLen ? matchLen - MIN_MATCH : 0;
+    unsigned char token = static_cast<unsigned char>(((litLen < 15 ? litLen : 15) << 4) | (m < 15 ? m : 15));
+    out.push_back(static_cast<char>(token));
+    if (litLen >= 15) putLength(out, litLen - 15);
+    out.append(reinterpret_cast<const char*>(lit), litLen);
+    if (!matchLen) return;
+    out.push_back(static_cast<char>(offset & 0xFF));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (m >= 15) putLength(out, m - 15);
+}
+
+// Appends the compressed form of 'in' to 'out'
+inline void compress(const char* data, size_t size, std::string& out) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(data);
+    std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0); // Position + 1, 0 = empty
+
+    size_t anchor = 0, pos = 0;
+    size_t limit = size > LAST_LITERALS + MIN_MATCH ? size - LAST_LITERALS - MIN_MATCH : 0;
+    while (pos < limit) {
+        uint32_t h = hash4(read32(in + pos));
+        size_t candidate = table[h];
+        table[h] = static_cast<uint32_t>(pos + 1);
+        if (candidate == 0 || pos - (candidate - 1) > MAX_OFFSET || read32(in + candidate - 1) != read32(in + pos)) {
+            ++pos;
+            continue;
+        }
+        size_t ref = candidate - 1;
+        size_t len = MIN_MATCH;
+        size_t maxLen = size - LAST_LITERALS - pos;
+        while (len < maxLen && in[ref + len] == in[pos + len]) ++len;
+
+        putSequence(out, in + anchor, pos - anchor, pos - ref, len);
+        pos += len;
+        anchor = pos;
+    }
+    putSequence(out, in + anchor, size - anchor, 0, 0);
+}
+
+inline bool getLength(const unsigned char*& p, const unsigned char* end, size_t& len) {
+    unsigned char b;
+    do {
+        if (p >= end) return false;
+        b = *p++;
+        len += b;
+    } while (b == 255);
+    return true;
+}
+
+// Decompresses a block whose original size is known; false if it is malformed
+inline bool decompress(const char* data, size_t size, size_t rawSize, std::string& out) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    out.clear();
+    out.reserve(rawSize);
+
+    while (p < end) {
+        unsigned char token = *p++;
+        size_t litLen = token >> 4;
+        if (litLen == 15 && !getLength(p, end, litLen)) return false;
+        if (static_cast<size_t>(end - p) < litLen || out.size() + litLen > rawSize) return false;
+        out.append(reinterpret_cast<const char*>(p), litLen);
+        p += litLen;
+        if (p == end) break; // Last sequence
+
+        if (end - p < 2) return false;
+        size_t offset = p[0] | (p[1] << 8);
+        p += 2;
+        size_t matchLen = token & 0x0F;
+        if (matchLen == 15 && !getLength(p, end, matchLen)) return false;
+        matchLen += MIN_MATCH;
+        if (offset == 0 || offset > out.size() || out.size() + matchLen > rawSize) return false;
+
+        // Byte by byte: the match may overlap what it is copying
+        size_t from = out.size() - offset;
+        for (size_t i = 0; i < matchLen; ++i) out.push_back(out[from + i]);
+    }
+    return out.size() == rawSize;
+}
+
+} // namespace lz
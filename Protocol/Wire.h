@@ -0,0 +1,97 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstring>
+
+// Helpers for the binary frames (network byte order). Header-only so the
+// client can use them too.
+
+class WireWriter {
+private:
+    std::string& out;
+
+public:
+    explicit WireWriter(std::string& buffer) : out(buffer) {}
+
+    void put8(uint8_t v) { out.push_back(static_cast<char>(v)); }
+    void put16(uint16_t v) { put8(v >> 8); put8(v & 0xFF); }
+    void put32(uint32_t v) { put16(v >> 16); put16(v & 0xFFFF); }
+    void put64(uint64_t v) { put32(static_cast<uint32_t>(v >> 32)); put32(static_cast<uint32_t>(v)); }
+
+    // LEB128 varint: 7 bits per byte, small values take one byte
+    void putVarint(uint64_t v) {
+        while (v >= 0x80) {
+            put8(static_cast<uint8_t>(v) | 0x80);
+            v >>= 7;
+        }
+        put8(static_cast<uint8_t>(v));
+    }
+    // Signed values (delays can be negative) mapped so small magnitudes stay small
+    void putZigzag(int64_t v) { putVarint((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63)); }
+
+    void putString(const std::string& s) {
+        putVarint(s.size());
+        out.append(s);
+    }
+
+    // Short string with a one byte length (longer values are cut at 255 bytes)
+    void putString8(const std::string& s) {
+        size_t len = s.size() < 255 ? s.size() : 255;
+        put8(static_cast<uint8_t>(len));
+        out.append(s.data(), len);
+    }
+};
+
+class WireReader {
+private:
+    const unsigned char* p;
+    const unsigned char* end;
+    bool valid = true;
+
+public:
+    WireReader(const char* data, size_t size)
+        : p(reinterpret_cast<const unsigned char*>(data)), end(p + size) {}
+
+    // False once a read went past the end of the frame
+    bool ok() const { return valid; }
+    size_t remaining() const { return end - p; }
+
+    uint8_t get8() {
+        if (p >= end) { valid = false; return 0; }
+        return *p++;
+    }
+    uint16_t get16() { uint16_t hi = get8(); return static_cast<uint16_t>((hi << 8) | get8()); }
+    uint32_t get32() { uint32_t hi = get16(); return (hi << 16) | get16(); }
+    uint64_t get64() { uint64_t hi = get32(); return (hi << 32) | get32(); }
+
+    uint64_t getVarint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b = get8();
+            v |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        valid = false;
+        return 0;
+    }
+    int64_t getZigzag() {
+        uint64_t v = getVarint();
+        return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+    }
+
+    std::string getString() {
+        uint64_t len = getVarint();
+        if (remaining() < len) { valid = false; return ""; }
+        std::string s(reinterpret_cast<const char*>(p), len);
+        p += len;
+        return s;
+    }
+
+    std::string getString8() {
+        size_t len = get8();
+        if (remaining() < len) { valid = false; return ""; }
+        std::string s(reinterpret_cast<const char*>(p), len);
+        p += len;
+        return s;
+    }
+};
@@ -0,0 +1,155 @@
+#include "DelayJournal.h"
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+// One file index entry every INDEX_STEP events
+static const uint64_t INDEX_STEP = 1024;
+// Longest record payload: seq, time, train, delay and an estimate of up to 255 bytes
+static const uint32_t MAX_RECORD = 8 + 8 + 4 + 4 + 1 + 255;
+
+int64_t nowMillis() {
+    using namespace chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+DelayJournal::DelayJournal(size_t ringCapacity) : capacity(ringCapacity) {
+    // Start time + PID: a restarted primary never reuses an epoch
+    using namespace chrono;
+    epochID = static_cast<uint64_t>(duration_cast<microseconds>(system_clock::now().time_since_epoch()).count())
+              ^ (static_cast<uint64_t>(getpid()) << 48);
+}
+
+DelayJournal::~DelayJournal() = default;
+
+DelayJournal::JournalFile::~JournalFile() {
+    close(fd);
+}
+
+void DelayJournal::openFile(const string& path) {
+    lock_guard<mutex> lock(mtx);
+    file.reset();
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror("[Journal] Could not open journal file");
+        return;
+    }
+    file = make_shared<const JournalFile>(fd);
+    fileSize = 0;
+    fileIndex.clear();
+    // Events already in memory (none at startup) would be missing from the file
+    if (!ring.empty()) {
+        cerr << "[Journal] Journal file opened late, older events only in memory\n";
+    }
+}
+
+uint64_t DelayJournal::append(int trainID, int delayMinutes, const string& estimate) {
+    uint64_t seq;
+    {
+        lock_guard<mutex> lock(mtx);
+        seq = nextSeq++;
+        DelayEvent e{ seq, nowMillis(), trainID, delayMinutes, estimate };
+
+        if (file) {
+            // Record: u32 length + payload
+            record.clear();
+            WireWriter w(record);
+            w.put32(0);
+            w.put64(e.seq);
+            w.put64(static_cast<uint64_t>(e.timeMs));
+            w.put32(static_cast<uint32_t>(e.trainID));
+            w.put32(static_cast<uint32_t>(e.delayMinutes));
+            w.putString8(e.estimate);
+            uint32_t len = record.size() - 4;
+            record[0] = len >> 24; record[1] = len >> 16; record[2] = len >> 8; record[3] = len;
+
+            if ((seq - 1) % INDEX_STEP == 0) fileIndex.push_back({ seq, fileSize });
+            if (write(file->fd, record.data(), record.size()) == (ssize_t)record.size()) {
+                fileSize += record.size();
+            } else {
+                perror("[Journal] write failed, disk journal disabled");
+                file.reset(); // Closed once the last reader is done with it
+            }
+        }
+
+        if (ring.size() < capacity) ring.push_back(move(e));
+        else ring[(seq - 1) % capacity] = move(e);
+    }
+    cv.notify_all();
+    return seq;
+}
+
+uint64_t DelayJournal::head() const {
+    lock_guard<mutex> lock(mtx);
+    return nextSeq - 1;
+}
+
+bool DelayJournal::covers(uint64_t after) const {
+    lock_guard<mutex> lock(mtx);
+    if (after >= nextSeq) return false; // From the future: another epoch
+    return after + 1 >= firstInRing() || file != nullptr;
+}
+
+// Reads events after..upTo (exclusive of 'after') from the file region [start, end)
+void DelayJournal::readFromFile(const JournalFile& f, uint64_t after, uint64_t upTo, off_t start, off_t end,
+                                vector<DelayEvent>& out) {
+    string chunk;
+    off_t pos = start;
+    while (pos < end && out.size() < MAX_BATCH) {
+        uint32_t len;
+        unsigned char hdr[4];
+        if (pread(f.fd, hdr, 4, pos) != 4) break;
+        len = (uint32_t(hdr[0]) << 24) | (hdr[1] << 16) | (hdr[2] << 8) | hdr[3];
+        if (len > MAX_RECORD || len > end - pos - 4) {
+            cerr << "[Journal] Corrupt record at offset " << pos << ", stopping the read\n";
+            break;
+        }
+        chunk.resize(len);
+        if (pread(f.fd, &chunk[0], len, pos + 4) != (ssize_t)len) break;
+        pos += 4 + len;
+
+        WireReader r(chunk.data(), chunk.size());
+        DelayEvent e;
+        e.seq = r.get64();
+        e.timeMs = static_cast<int64_t>(r.get64());
+        e.trainID = static_cast<int32_t>(r.get32());
+        e.delayMinutes = static_cast<int32_t>(r.get32());
+        e.estimate = r.getString8();
+        if (!r.ok()) break;
+        if (e.seq <= after) continue;
+        if (e.seq > upTo) break;
+        out.push_back(move(e));
+    }
+}
+
+bool DelayJournal::waitAndRead(uint64_t after, vector<DelayEvent>& out, chrono::milliseconds timeout) {
+    unique_lock<mutex> lock(mtx);
+    cv.wait_for(lock, timeout, [&]{ return nextSeq - 1 > after; });
+    if (nextSeq - 1 <= after) return false;
+
+    uint64_t first = firstInRing();
+    if (after + 1 < first) {
+        // Older than the ring: serve this batch from the journal file
+        if (!file) return false;
+        shared_ptr<const JournalFile> f = file;
+        auto it = upper_bound(fileIndex.begin(), fileIndex.end(), after + 1,
+                              [](uint64_t seq, const pair<uint64_t, off_t>& e) { return seq < e.first; });
+        off_t start = (it == fileIndex.begin()) ? 0 : prev(it)->second;
+        off_t end = fileSize;
+        lock.unlock();
+
+        size_t before = out.size();
+        readFromFile(*f, after, first - 1, start, end, out);
+        return out.size() > before;
+    }
+
+    uint64_t last = min(nextSeq - 1, after + MAX_BATCH);
+    for (uint64_t seq = after + 1; seq <= last; ++seq) {
+        out.push_back(ring[(seq - 1) % capacity]);
+    }
+    return true;
+}
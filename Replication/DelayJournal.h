@@ -0,0 +1,70 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <sys/types.h>
+#include "../Protocol/FeedCodec.h"
+
+// Sequence-numbered log of every delay applied by this process.
+// Replicas and feed consumers resume from the last sequence they saw.
+//
+// The most recent events stay in a bounded in-memory ring; every event is
+// also appended to a journal file, which is only read when a consumer
+// resumes from further back than the ring reaches.
+class DelayJournal {
+private:
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    uint64_t epochID;     // Changes on every start; sequences restart with it
+    uint64_t nextSeq = 1;
+
+    std::vector<DelayEvent> ring; // Event 'seq' lives at ring[(seq - 1) % capacity]
+    size_t capacity;
+
+    // The journal file. Readers hold a reference while they read outside the
+    // lock, so a write error that drops the file cannot close it under them.
+    struct JournalFile {
+        int fd;
+        explicit JournalFile(int descriptor) : fd(descriptor) {}
+        ~JournalFile();
+    };
+    std::shared_ptr<const JournalFile> file;
+    off_t fileSize = 0;
+    std::string record;   // Reused encode buffer for the file
+    std::vector<std::pair<uint64_t, off_t>> fileIndex; // Offset of every INDEX_STEP-th event
+
+    uint64_t firstInRing() const { return nextSeq - ring.size(); }
+    static void readFromFile(const JournalFile& f, uint64_t after, uint64_t upTo, off_t start, off_t end,
+                             std::vector<DelayEvent>& out);
+
+public:
+    // Events handed out by one waitAndRead call at most
+    static const size_t MAX_BATCH = 4096;
+
+    explicit DelayJournal(size_t ringCapacity = 65536);
+    ~DelayJournal();
+
+    uint64_t epoch() const { return epochID; }
+
+    // Starts the on-disk journal (truncated: sequences restart with the epoch)
+    void openFile(const std::string& path);
+
+    // Appends an event and wakes up waiting readers. Returns its sequence.
+    uint64_t append(int trainID, int delayMinutes, const std::string& estimate);
+
+    // Last sequence written (0 if none)
+    uint64_t head() const;
+
+    // True if every event after 'after' is still available (ring or file)
+    bool covers(uint64_t after) const;
+
+    // Copies up to MAX_BATCH events with seq > after into 'out'. If there are
+    // none yet, waits up to 'timeout' for new ones. Returns false if none arrived.
+    bool waitAndRead(uint64_t after, std::vector<DelayEvent>& out, std::chrono::milliseconds timeout);
+};
+
+int64_t nowMillis();
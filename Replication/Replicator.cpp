@@ -0,0 +1,172 @@
+#include "Replicator.h"
+#include "../Commands/Command.h"
+#include "../Network/Outbox.h"
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+using namespace std;
+
+// Reads one length-prefixed frame
+static bool receiveFrame(int sock, string& out) {
+    uint32_t networkLen;
+    if (recv(sock, &networkLen, sizeof(networkLen), MSG_WAITALL) != sizeof(networkLen)) return false;
+    uint32_t length = ntohl(networkLen);
+    out.resize(length);
+    size_t total = 0;
+    while (total < length) {
+        ssize_t chunk = recv(sock, &out[total], length - total, 0);
+        if (chunk <= 0) return false;
+        total += chunk;
+    }
+    return true;
+}
+
+static int connectTo(const string& host, int port) {
+    addrinfo hints{}, *res = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &res) != 0) return -1;
+
+    int sock = socket(res->ai_family, res->ai_socktype, 0);
+    if (sock >= 0 && connect(sock, res->ai_addr, res->ai_addrlen) < 0) {
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    return sock;
+}
+
+// --- PRIMARY SIDE ---
+
+void Replicator::serveStream(uint64_t connection, uint64_t epoch, uint64_t lastSeq, bool toReplica) {
+    DelayJournal& journal = tm.delayJournal();
+    const char* who = toReplica ? "Replica" : "Feed consumer";
+    atomic<int>& counter = toReplica ? connectedReplicas : connectedFeeds;
+    ++counter;
+    cout << "[Replication] " << who << " " << connection << " connected, resuming after seq " << lastSeq << endl;
+
+    FeedEncoder encoder; // Per-stream estimate dictionary
+    string frame;
+    uint64_t after = lastSeq;
+
+    if (epoch != journal.epoch() || !journal.covers(lastSeq)) {
+        // Cannot resume from the journal: send the full delay state first
+        vector<DelayEvent> snapshot;
+        after = tm.snapshotDelays(snapshot);
+        encoder.snapshot(frame, journal.epoch(), after, snapshot);
+        cout << "[Replication] Sent snapshot of " << snapshot.size() << " trains to " << connection << endl;
+    }
+
+    auto box = Outbox::find(connection);
+    if (!box) return;
+    vector<DelayEvent> batch;
+    while (true) {
+        if (!frame.empty() && !box->send(Frame::make(move(frame)))) break;
+        box->waitBacklog(Outbox::MAX_BACKLOG); // Sends do not block; read no further ahead than this
+
+        // Wait for new entries; when idle, the heartbeat keeps the consumer's lag current
+        batch.clear();
+        frame.clear();
+        if (journal.waitAndRead(after, batch, chrono::milliseconds(500))) {
+            encoder.changes(frame, batch);
+            after = batch.back().seq;
+        } else {
+            encoder.heartbeat(frame, journal.head(), nowMillis());
+        }
+    }
+
+    --counter;
+    cout << "[Replication] " << who << " " << connection << " disconnected at seq " << after << endl;
+}
+
+// --- REPLICA SIDE ---
+
+void Replicator::startReplica(const string& host, int port) {
+    replica = true;
+    primaryHost = host;
+    primaryPort = port;
+    thread(&Replicator::runReplica, this).detach();
+}
+
+bool Replicator::applyFrame(const FeedDecoder::Frame& frame) {
+    if (frame.type == 'S') {
+        tm.updateDelays(frame.events);
+        primaryEpoch = frame.epoch;
+        appliedSeq = frame.head;
+        primaryHead = frame.head;
+        cout << "[Replication] Applied snapshot of " << frame.events.size() << " trains at seq " << frame.head << endl;
+    }
+    else if (frame.type == 'E') {
+        if (frame.events.empty() || frame.events.front().seq != appliedSeq + 1) {
+            cerr << "[Replication] Sequence gap after " << appliedSeq << ", resyncing\n";
+            return false;
+        }
+        tm.updateDelays(frame.events);
+        appliedSeq = frame.events.back().seq;
+        if (primaryHead < appliedSeq) primaryHead = appliedSeq.load();
+        lastApplyLagMs = nowMillis() - frame.events.back().timeMs;
+    }
+    else if (frame.type == 'H') {
+        primaryHead = frame.head;
+    }
+    lastFrameMs = nowMillis();
+    return true;
+}
+
+void Replicator::runReplica() {
+    while (true) {
+        int sock = connectTo(primaryHost, primaryPort);
+        if (sock < 0) {
+            this_thread::sleep_for(chrono::seconds(1));
+            continue;
+        }
+
+        // The primary sends at least a heartbeat every 500 ms
+        timeval tv{ 3, 0 };
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        string request = "REPLICATE " + to_string(primaryEpoch.load()) + " " + to_string(appliedSeq.load());
+        if (send(sock, request.c_str(), request.size(), 0) == (ssize_t)request.size()) {
+            connected = true;
+            cout << "[Replication] Connected to primary " << primaryHost << ":" << primaryPort
+                 << ", resuming after seq " << appliedSeq << endl;
+
+            FeedDecoder decoder; // Fresh dictionary for every connection
+            FeedDecoder::Frame decoded;
+            string frame;
+            while (receiveFrame(sock, frame) && decoder.decode(frame, decoded) && applyFrame(decoded)) {}
+            connected = false;
+            cout << "[Replication] Lost primary, last applied seq " << appliedSeq << ". Reconnecting...\n";
+        }
+        close(sock);
+        this_thread::sleep_for(chrono::seconds(1));
+    }
+}
+
+string Replicator::status() const {
+    stringstream ss;
+    if (!replica) {
+        const DelayJournal& journal = tm.delayJournal();
+        ss << "Role: primary\n"
+           << "Epoch: " << journal.epoch() << "\n"
+           << "Head seq: " << journal.head() << "\n"
+           << "Connected replicas: " << connectedReplicas << "\n"
+           << "Feed consumers: " << connectedFeeds << "\n";
+        return ss.str();
+    }
+
+    uint64_t applied = appliedSeq, head = primaryHead;
+    ss << "Role: replica of " << primaryHost << ":" << primaryPort << "\n"
+       << "Connected: " << (connected ? "yes" : "no") << "\n"
+       << "Applied seq: " << applied << " / primary head " << head << "\n"
+       << "Lag: " << (head > applied ? head - applied : 0) << " entries, "
+       << lastApplyLagMs << " ms (last entry)\n";
+    if (lastFrameMs > 0) ss << "Last frame from primary: " << (nowMillis() - lastFrameMs) << " ms ago\n";
+    return ss.str();
+}
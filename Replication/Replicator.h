@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include "../TrainManager/TrainManager.h"
+
+// Primary/replica streaming of the delay journal, and the change feed.
+//
+// A replica connects to the primary's normal port and sends
+// "REPLICATE <epoch> <lastSeq>"; a feed consumer sends "FEED <epoch> <lastSeq>".
+// Both get the same stream of FeedCodec frames on that connection:
+//   'S' snapshot of every train's delay (when it cannot resume from lastSeq)
+//   'E' a batch of journal entries, in sequence order
+//   'H' heartbeat with the head sequence and clock
+// The replica applies entries to its own TrainManager and reconnects with
+// its last applied sequence after a disconnect.
+class Replicator {
+private:
+    TrainManager& tm;
+
+    // Primary side
+    std::atomic<int> connectedReplicas{0};
+    std::atomic<int> connectedFeeds{0};
+
+    // Replica side
+    bool replica = false;
+    std::string primaryHost;
+    int primaryPort = 0;
+    std::atomic<bool> connected{false};
+    std::atomic<uint64_t> primaryEpoch{0};
+    std::atomic<uint64_t> appliedSeq{0};
+    std::atomic<uint64_t> primaryHead{0};
+    std::atomic<int64_t> lastApplyLagMs{0};  // Primary apply -> replica apply, last entry
+    std::atomic<int64_t> lastFrameMs{0};
+
+    void runReplica();
+    bool applyFrame(const FeedDecoder::Frame& frame);
+
+public:
+    explicit Replicator(TrainManager& manager) : tm(manager) {}
+
+    // Replica mode: follows the primary from a background thread
+    void startReplica(const std::string& host, int port);
+    bool isReplica() const { return replica; }
+
+    // Streams the journal to one replica or feed consumer. Runs on that
+    // client's thread and returns when it disconnects.
+    void serveStream(uint64_t connection, uint64_t epoch, uint64_t lastSeq, bool toReplica);
+
+    // Role, sequences and lag, for REPLICATION_STATUS
+    std::string status() const;
+};
@@ -0,0 +1,201 @@
+#include "ShmPublisher.h"
+#include "../TrainManager/TimeOfDay.h"
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <new>
+#include <cstdio>
+
+using namespace std;
+
+static size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+ShmPublisher::~ShmPublisher() {
+    if (!base) return;
+    munmap(base, capacity);
+    shm_unlink(name.c_str());
+}
+
+bool ShmPublisher::open(const string& segmentName) {
+    name = segmentName;
+    if (name.empty() || name[0] != '/') name = "/" + name;
+    return create(MIN_CAPACITY);
+}
+
+// POSIX shared memory objects are the files of /dev/shm on Linux, which is
+// what makes the rename below possible
+static string shmPath(const string& segment) { return "/dev/shm" + segment; }
+
+bool ShmPublisher::create(size_t bytes) {
+    // Built under a temporary name: until the rename, 'name' still leads to
+    // the current segment, and its readers keep it mapped until they re-attach
+    string building = name + ".new";
+    shm_unlink(building.c_str()); // Left over by a crash
+    int fd = shm_open(building.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        perror("[Shm] shm_open failed");
+        return false;
+    }
+    if (ftruncate(fd, bytes) < 0) {
+        perror("[Shm] ftruncate failed");
+        close(fd);
+        shm_unlink(building.c_str());
+        return false;
+    }
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        perror("[Shm] mmap failed");
+        shm_unlink(building.c_str());
+        return false;
+    }
+
+    // A reader that attaches right after the rename finds a valid header
+    ShmHeader* h = new (p) ShmHeader();
+    h->magic = SHM_MAGIC;
+    h->layout = SHM_LAYOUT;
+    h->capacity = bytes;
+    h->minute.store(minute, memory_order_release);
+    if (rename(shmPath(building).c_str(), shmPath(name).c_str()) < 0) {
+        perror("[Shm] rename failed");
+        munmap(p, bytes);
+        shm_unlink(building.c_str());
+        return false;
+    }
+
+    base = static_cast<unsigned char*>(p);
+    capacity = bytes;
+    return true;
+}
+
+void ShmPublisher::beginWrite() {
+    ShmHeader* h = header();
+    h->seq.store(h->seq.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+void ShmPublisher::endWrite() {
+    header()->seq.fetch_add(1, memory_order_release);
+}
+
+static void copyEstimate(char* slot, const string& estimate) {
+    size_t n = min(estimate.size(), SHM_ESTIMATE - 1);
+    memcpy(slot, estimate.data(), n);
+    memset(slot + n, 0, SHM_ESTIMATE - n);
+}
+
+void ShmPublisher::publish(const Timetable& timetable) {
+    lock_guard<mutex> lock(mtx);
+    if (!base) return;
+
+    vector<const string*> stations;
+    stations.reserve(timetable.stationIndex.size());
+    size_t stopCount = 0, refCount = 0, namesSize = 0;
+    for (const auto& entry : timetable.stationIndex) {
+        stations.push_back(&entry.first);
+        refCount += entry.second.size();
+        namesSize += entry.first.size();
+    }
+    sort(stations.begin(), stations.end(), [](const string* a, const string* b) { return *a < *b; });
+    for (const auto& pair : timetable.trains) stopCount += pair.second.route.size();
+
+    ShmHeader layout{};
+    layout.trainCount = timetable.trains.size();
+    layout.stationCount = stations.size();
+    layout.stopCount = stopCount;
+    layout.refCount = refCount;
+    layout.namesSize = namesSize;
+    layout.trainsOffset = align8(sizeof(ShmHeader));
+    layout.stopsOffset = align8(layout.trainsOffset + layout.trainCount * sizeof(ShmTrain));
+    layout.stationsOffset = align8(layout.stopsOffset + stopCount * sizeof(ShmStop));
+    layout.refsOffset = align8(layout.stationsOffset + layout.stationCount * sizeof(ShmStation));
+    layout.namesOffset = align8(layout.refsOffset + refCount * sizeof(ShmStopRef));
+    size_t needed = layout.namesOffset + namesSize;
+
+    unsigned char* old = nullptr;
+    size_t oldCapacity = capacity;
+    if (needed > capacity) {
+        old = base;
+        if (!create(max(needed * 2, size_t(MIN_CAPACITY)))) {
+            // Keep serving the old layout
+            base = old;
+            capacity = oldCapacity;
+            return;
+        }
+    }
+
+    unordered_map<string, uint32_t> stationID;
+    for (uint32_t i = 0; i < stations.size(); ++i) stationID[*stations[i]] = i;
+
+    beginWrite();
+    ShmHeader* h = header();
+    h->trainCount = layout.trainCount;
+    h->stationCount = layout.stationCount;
+    h->stopCount = layout.stopCount;
+    h->refCount = layout.refCount;
+    h->namesSize = layout.namesSize;
+    h->trainsOffset = layout.trainsOffset;
+    h->stopsOffset = layout.stopsOffset;
+    h->stationsOffset = layout.stationsOffset;
+    h->refsOffset = layout.refsOffset;
+    h->namesOffset = layout.namesOffset;
+
+    ShmTrain* trains = reinterpret_cast<ShmTrain*>(base + layout.trainsOffset);
+    ShmStop* stops = reinterpret_cast<ShmStop*>(base + layout.stopsOffset);
+    slotOf.clear();
+    uint32_t slot = 0, stop = 0;
+    for (const auto& pair : timetable.trains) {
+        const Train& t = pair.second;
+        ShmTrain& out = trains[slot];
+        out.trainID = t.trainID;
+        out.delayMinutes = t.delayMinutes;
+        out.firstStop = stop;
+        out.stopCount = t.route.size();
+        copyEstimate(out.estimate, t.estimate);
+        for (const auto& s : t.route) {
+            stops[stop++] = { stationID[s.name], static_cast<int16_t>(timeofday::toMinutes(s.arrivalTime)),
+                              static_cast<int16_t>(timeofday::toMinutes(s.departureTime)) };
+        }
+        slotOf[t.trainID] = slot++;
+    }
+
+    ShmStation* stationOut = reinterpret_cast<ShmStation*>(base + layout.stationsOffset);
+    ShmStopRef* refs = reinterpret_cast<ShmStopRef*>(base + layout.refsOffset);
+    char* names = reinterpret_cast<char*>(base + layout.namesOffset);
+    uint32_t ref = 0, nameOffset = 0;
+    for (uint32_t i = 0; i < stations.size(); ++i) {
+        const string& station = *stations[i];
+        const vector<StopRef>& index = timetable.stationIndex.at(station);
+        stationOut[i] = { nameOffset, static_cast<uint32_t>(station.size()), ref, static_cast<uint32_t>(index.size()) };
+        memcpy(names + nameOffset, station.data(), station.size());
+        nameOffset += station.size();
+        for (const auto& r : index) refs[ref++] = { slotOf[r.trainID], static_cast<uint32_t>(r.stopIndex) };
+    }
+    endWrite();
+
+    if (old) {
+        reinterpret_cast<ShmHeader*>(old)->replaced.store(1, memory_order_release);
+        munmap(old, oldCapacity);
+    }
+    cout << "[Shm] Published " << layout.trainCount << " trains, " << layout.stationCount << " stations ("
+         << needed / 1024 << " of " << capacity / 1024 << " KB) to " << name << endl;
+}
+
+void ShmPublisher::setMinute(int minuteOfDay) {
+    lock_guard<mutex> lock(mtx);
+    minute = minuteOfDay;
+    if (base) header()->minute.store(minute, memory_order_release);
+}
+
+void ShmPublisher::trainChanged(const Train& t) {
+    lock_guard<mutex> lock(mtx);
+    if (!base) return;
+    auto it = slotOf.find(t.trainID);
+    if (it == slotOf.end()) return;
+
+    ShmTrain& slot = reinterpret_cast<ShmTrain*>(base + header()->trainsOffset)[it->second];
+    beginWrite();
+    slot.delayMinutes = t.delayMinutes;
+    copyEstimate(slot.estimate, t.estimate);
+    endWrite();
+}
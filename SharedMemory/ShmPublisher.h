@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <mutex>
+#include <unordered_map>
+#include "ShmTimetable.h"
+#include "../TrainManager/TrainManager.h"
+
+// Writer side of ShmTimetable (--shm <Name>). Registered as a timetable and
+// a delay listener, so it runs under the TrainManager lock and sees loads,
+// reloads and delays in the order they were applied.
+//
+// A reload rewrites the whole layout; a delay rewrites one train slot. Both
+// are enclosed in the seqlock. When a layout does not fit, a segment twice
+// the size is created under a temporary name and renamed over the old one,
+// so the name always leads to a usable segment, even if that fails.
+//
+// The header also carries the server's current minute (setMinute), so
+// readers' departure boards follow --clock like the server's own.
+class ShmPublisher {
+private:
+    static const size_t MIN_CAPACITY = 1 << 20;
+
+    std::string name;
+    unsigned char* base = nullptr;
+    size_t capacity = 0;
+    std::unordered_map<int, uint32_t> slotOf; // Train ID -> index in the trains
+    int minute = -1;
+    std::mutex mtx;
+
+    ShmHeader* header() { return reinterpret_cast<ShmHeader*>(base); }
+    // Creates a fresh segment and gives it 'name'; the current one (if any)
+    // is left untouched when this fails
+    bool create(size_t bytes);
+    void beginWrite();
+    void endWrite();
+
+public:
+    ~ShmPublisher();
+
+    bool open(const std::string& segmentName);
+    bool running() const { return base != nullptr; }
+
+    void publish(const Timetable& timetable);
+    void trainChanged(const Train& t);
+    // The server's clock moved (MinuteClock listener)
+    void setMinute(int minuteOfDay);
+};
@@ -0,0 +1,277 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Read-only view of the server's timetable in POSIX shared memory (--shm).
+// Header-only: a process on the same host includes this file, attaches
+// once, and then answers train and board queries from the mapped pages,
+// with no socket and no system call.
+//
+// The server rewrites the segment under a seqlock: the sequence is odd
+// while a write is in progress. A reader copies what it needs and starts
+// again if the sequence moved meanwhile, so it never sees half a delay
+// update or half a reload. Every offset is checked against the mapping
+// before it is followed, because a copy made during a write may be torn.
+//
+// When a reload no longer fits, the server creates a larger segment under
+// the same name and marks the old one replaced(); attach() again.
+
+static const uint32_t SHM_MAGIC = 0x43465254; // "CFRT"
+static const uint32_t SHM_LAYOUT = 2;
+static const size_t SHM_ESTIMATE = 32;        // Longer estimates are cut
+
+struct ShmHeader {
+    uint32_t magic;
+    uint32_t layout;
+    std::atomic<uint64_t> seq;       // Odd while the server writes
+    std::atomic<uint32_t> replaced;  // 1: a new segment took the name
+    std::atomic<int32_t> minute;     // The server's current minute of the day, -1 until known
+    uint32_t trainCount;
+    uint32_t stationCount;
+    uint32_t stopCount;
+    uint32_t refCount;
+    uint64_t capacity;               // Bytes of the segment
+    uint64_t trainsOffset;           // ShmTrain[trainCount], by train ID
+    uint64_t stopsOffset;            // ShmStop[stopCount], each train's route in order
+    uint64_t stationsOffset;         // ShmStation[stationCount], by name
+    uint64_t refsOffset;             // ShmStopRef[refCount], each station's stops in train ID order
+    uint64_t namesOffset;            // Station names, back to back
+    uint64_t namesSize;
+};
+
+struct ShmTrain {
+    int32_t trainID;
+    int32_t delayMinutes;
+    uint32_t firstStop;
+    uint32_t stopCount;
+    char estimate[SHM_ESTIMATE];     // Zero-padded
+};
+
+struct ShmStop {
+    uint32_t station;
+    int16_t arrival;                 // Minutes of the day, -1 for none
+    int16_t departure;
+};
+
+struct ShmStation {
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t firstRef;
+    uint32_t refCount;
+};
+
+struct ShmStopRef {
+    uint32_t train;                  // Index into the trains
+    uint32_t stop;                   // Index into that train's route
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the seqlock needs lock-free 64-bit atomics");
+
+// Query results, copied out of the segment
+struct ShmStopInfo {
+    std::string station;
+    int arrival;                     // Minutes of the day, -1 for none
+    int departure;
+};
+
+struct ShmTrainInfo {
+    int trainID;
+    int delayMinutes;
+    std::string estimate;
+    std::vector<ShmStopInfo> route;
+};
+
+struct ShmBoardRow {
+    int trainID;
+    int stopIndex;
+    int departure;                   // Real departure, minutes of the day
+    int delayMinutes;
+    std::string destination;
+};
+
+class ShmTimetable {
+private:
+    static const int MAX_ATTEMPTS = 1 << 20; // A writer that died mid-write
+
+    const unsigned char* base = nullptr;
+    size_t size = 0;
+
+    const ShmHeader* header() const { return reinterpret_cast<const ShmHeader*>(base); }
+
+    // count elements of T at offset, or nullptr if they are not all inside the mapping
+    template <typename T>
+    const T* at(uint64_t offset, uint64_t count) const {
+        if (offset > size || count > (size - offset) / sizeof(T)) return nullptr;
+        return reinterpret_cast<const T*>(base + offset);
+    }
+
+    bool name(const ShmHeader& h, const ShmStation& s, std::string& out) const {
+        if (s.nameOffset > h.namesSize || s.nameLength > h.namesSize - s.nameOffset) return false;
+        const char* p = at<char>(h.namesOffset + s.nameOffset, s.nameLength);
+        if (!p) return false;
+        out.assign(p, s.nameLength);
+        return true;
+    }
+
+    const ShmTrain* findTrain(const ShmHeader& h, int id) const {
+        const ShmTrain* trains = at<ShmTrain>(h.trainsOffset, h.trainCount);
+        if (!trains) return nullptr;
+        size_t lo = 0, hi = h.trainCount;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (trains[mid].trainID < id) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo < h.trainCount && trains[lo].trainID == id ? &trains[lo] : nullptr;
+    }
+
+    const ShmStation* findStation(const ShmHeader& h, const std::string& station) const {
+        const ShmStation* stations = at<ShmStation>(h.stationsOffset, h.stationCount);
+        const char* names = at<char>(h.namesOffset, h.namesSize);
+        if (!stations || !names) return nullptr;
+        size_t lo = 0, hi = h.stationCount;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            const ShmStation& s = stations[mid];
+            if (s.nameOffset > h.namesSize || s.nameLength > h.namesSize - s.nameOffset) return nullptr;
+            int cmp = station.compare(0, std::string::npos, names + s.nameOffset, s.nameLength);
+            if (cmp == 0) return &s;
+            if (cmp > 0) lo = mid + 1;
+            else hi = mid;
+        }
+        return nullptr;
+    }
+
+    // Runs body until it completes without a write in between; false if
+    // the segment is unusable or the body found nothing
+    template <typename Body>
+    bool read(Body body) const {
+        if (!base) return false;
+        const ShmHeader& h = *header();
+        for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+            uint64_t before = h.seq.load(std::memory_order_acquire);
+            if (before & 1) continue; // Being written
+            bool found = body(h);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (h.seq.load(std::memory_order_relaxed) == before) return found;
+        }
+        return false;
+    }
+
+public:
+    ShmTimetable() = default;
+    ShmTimetable(const ShmTimetable&) = delete;
+    ShmTimetable& operator=(const ShmTimetable&) = delete;
+    ~ShmTimetable() { detach(); }
+
+    // Maps the segment the server publishes as 'name' (e.g. "/cfr-timetable")
+    bool attach(const std::string& name) {
+        detach();
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(ShmHeader)) {
+            close(fd);
+            return false;
+        }
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return false;
+
+        base = static_cast<const unsigned char*>(p);
+        size = st.st_size;
+        if (header()->magic != SHM_MAGIC || header()->layout != SHM_LAYOUT) {
+            detach();
+            return false;
+        }
+        return true;
+    }
+
+    void detach() {
+        if (base) munmap(const_cast<unsigned char*>(base), size);
+        base = nullptr;
+        size = 0;
+    }
+
+    bool attached() const { return base != nullptr; }
+    // The server moved to a new segment: attach() again
+    bool replaced() const { return base && header()->replaced.load(std::memory_order_acquire); }
+    // Changes with every update the server writes
+    uint64_t sequence() const { return base ? header()->seq.load(std::memory_order_acquire) / 2 : 0; }
+
+    // The server's current minute of the day (its --clock, or local time
+    // as it last ticked); local time if the server has not published one
+    int currentMinute() const {
+        int m = base ? header()->minute.load(std::memory_order_acquire) : -1;
+        if (m >= 0) return m;
+        time_t t = time(nullptr);
+        struct tm lt;
+        localtime_r(&t, &lt);
+        return lt.tm_hour * 60 + lt.tm_min;
+    }
+
+    // Route, delay and estimate of one train (what GET_TRAIN_INFO shows)
+    bool getTrain(int id, ShmTrainInfo& out) const {
+        return read([&](const ShmHeader& h) {
+            const ShmTrain* t = findTrain(h, id);
+            const ShmStop* stops = t ? at<ShmStop>(h.stopsOffset, h.stopCount) : nullptr;
+            const ShmStation* stations = at<ShmStation>(h.stationsOffset, h.stationCount);
+            if (!stops || !stations || t->firstStop > h.stopCount || t->stopCount > h.stopCount - t->firstStop) return false;
+
+            out.trainID = t->trainID;
+            out.delayMinutes = t->delayMinutes;
+            out.estimate.assign(t->estimate, strnlen(t->estimate, SHM_ESTIMATE));
+            out.route.resize(t->stopCount);
+            for (uint32_t i = 0; i < t->stopCount; ++i) {
+                const ShmStop& s = stops[t->firstStop + i];
+                if (s.station >= h.stationCount || !name(h, stations[s.station], out.route[i].station)) return false;
+                out.route[i].arrival = s.arrival;
+                out.route[i].departure = s.departure;
+            }
+            return true;
+        });
+    }
+
+    // Departures from the station in the hour after nowMin, like the server's
+    // departure boards; false if the station is unknown
+    bool departureBoard(const std::string& station, int nowMin, std::vector<ShmBoardRow>& rows) const {
+        return read([&](const ShmHeader& h) {
+            rows.clear();
+            const ShmStation* st = findStation(h, station);
+            const ShmTrain* trains = at<ShmTrain>(h.trainsOffset, h.trainCount);
+            const ShmStop* stops = at<ShmStop>(h.stopsOffset, h.stopCount);
+            const ShmStation* stations = at<ShmStation>(h.stationsOffset, h.stationCount);
+            const ShmStopRef* refs = st ? at<ShmStopRef>(h.refsOffset, h.refCount) : nullptr;
+            if (!refs || !trains || !stops || !stations || st->firstRef > h.refCount || st->refCount > h.refCount - st->firstRef) return false;
+
+            for (uint32_t i = 0; i < st->refCount; ++i) {
+                const ShmStopRef& ref = refs[st->firstRef + i];
+                if (ref.train >= h.trainCount) return false;
+                const ShmTrain& t = trains[ref.train];
+                if (t.firstStop > h.stopCount || t.stopCount > h.stopCount - t.firstStop || ref.stop >= t.stopCount) return false;
+                if (ref.stop + 1 >= t.stopCount) continue; // No departure from the last stop
+
+                int plan = stops[t.firstStop + ref.stop].departure;
+                if (plan < 0) continue;
+                int real = (plan + t.delayMinutes) % 1440;
+                if (real < 0) real += 1440;
+                int ahead = (real - nowMin + 1440) % 1440;
+                if (ahead > 60) continue;
+
+                uint32_t last = stops[t.firstStop + t.stopCount - 1].station;
+                ShmBoardRow row{ t.trainID, static_cast<int>(ref.stop), real, t.delayMinutes, "" };
+                if (last >= h.stationCount || !name(h, stations[last], row.destination)) return false;
+                rows.push_back(std::move(row));
+            }
+            return true;
+        });
+    }
+};
@@ -0,0 +1,134 @@
+#include "BoardMulticast.h"
+#include "BoardRegistry.h"
+#include "../TrainManager/TimeOfDay.h"
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+using namespace std;
+
+BoardMulticast::BoardMulticast() {
+    // Start time + PID, like the delay journal: receivers notice a restart
+    using namespace chrono;
+    epochID = static_cast<uint64_t>(duration_cast<microseconds>(system_clock::now().time_since_epoch()).count())
+              ^ (static_cast<uint64_t>(getpid()) << 48);
+}
+
+bool BoardMulticast::start(const string& groupAddress, const vector<string>& stations) {
+    size_t colon = groupAddress.find(':');
+    if (colon == string::npos || inet_pton(AF_INET, groupAddress.substr(0, colon).c_str(), &group.sin_addr) != 1) {
+        cerr << "[Multicast] Use --multicast <Group>:<Port>, e.g. 239.1.1.1:55000\n";
+        return false;
+    }
+    group.sin_family = AF_INET;
+    group.sin_port = htons(atoi(groupAddress.c_str() + colon + 1));
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("[Multicast] socket failed");
+        return false;
+    }
+    unsigned char hops = TTL;
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &hops, sizeof(hops));
+
+    lock_guard<mutex> lock(mtx);
+    for (const auto& st : stations) boards[st];
+    cout << "[Multicast] Publishing " << boards.size() << " boards to " << groupAddress << " (epoch " << epochID << ")\n";
+    return true;
+}
+
+void BoardMulticast::affectedStations(const Train& t, vector<string>& out) const {
+    if (fd < 0) return;
+    lock_guard<mutex> lock(mtx);
+    for (const auto& s : t.route) {
+        if (boards.count(s.name)) out.push_back(s.name);
+    }
+}
+
+void BoardMulticast::publish(const string& station, Board& board, const string& lines, bool full) {
+    size_t pos = 0;
+    bool first = true;
+    do {
+        string datagram = "[MCAST] " + to_string(epochID) + " " + to_string(++board.seq) + "\n"
+                        + "[BOARD] " + station + " " + timeofday::toTime(board.nowMin) + (full && first ? " FULL\n" : "\n");
+        // Whole rows only, so every datagram can be applied by itself
+        size_t room = datagram.size() < MAX_DATAGRAM ? MAX_DATAGRAM - datagram.size() : 0;
+        size_t end = pos;
+        while (end < lines.size()) {
+            size_t nl = lines.find('\n', end) + 1;
+            if (nl - pos > room && end > pos) break;
+            end = nl;
+        }
+        datagram.append(lines, pos, end - pos);
+        pos = end;
+        first = false;
+
+        if (sendto(fd, datagram.data(), datagram.size(), 0, (sockaddr*)&group, sizeof(group)) < 0) {
+            perror("[Multicast] sendto failed");
+        }
+    } while (pos < lines.size());
+}
+
+void BoardMulticast::refresh(TrainManager& tm, const vector<string>& stations) {
+    if (fd < 0) return;
+    vector<string> names = stations;
+    if (names.empty()) {
+        lock_guard<mutex> lock(mtx);
+        for (const auto& b : boards) names.push_back(b.first);
+    }
+
+    vector<BoardRow> rows;
+    for (const auto& station : names) {
+        // Read the timetable before taking our lock: delay listeners take them the other way round
+        int nowMin = tm.getDepartureBoard(station, rows);
+
+        lock_guard<mutex> lock(mtx);
+        auto it = boards.find(station);
+        if (it == boards.end()) continue;
+
+        string body;
+        diffBoardRows(it->second.rows, rows, body);
+        it->second.rows.swap(rows);
+        if (body.empty() && nowMin == it->second.nowMin) continue;
+        // A new minute is announced even without row changes
+        it->second.nowMin = nowMin;
+        publish(station, it->second, body, false);
+    }
+}
+
+void BoardMulticast::publishFull(TrainManager& tm) {
+    if (fd < 0) return;
+    vector<string> names;
+    {
+        lock_guard<mutex> lock(mtx);
+        for (const auto& b : boards) names.push_back(b.first);
+    }
+
+    vector<BoardRow> rows;
+    for (const auto& station : names) {
+        int nowMin = tm.getDepartureBoard(station, rows);
+
+        lock_guard<mutex> lock(mtx);
+        Board& board = boards[station];
+        board.rows.swap(rows);
+        board.nowMin = nowMin;
+        string body;
+        for (const auto& r : board.rows) appendBoardRow(body, '+', r);
+        publish(station, board, body, true);
+    }
+}
+
+bool BoardMulticast::snapshot(const string& station, string& out) const {
+    lock_guard<mutex> lock(mtx);
+    auto it = boards.find(station);
+    if (fd < 0 || it == boards.end()) return false;
+
+    const Board& board = it->second;
+    out = "[MCAST] " + to_string(epochID) + " " + to_string(board.seq) + "\n"
+        + "[BOARD] " + station + " " + timeofday::toTime(board.nowMin) + " FULL\n";
+    for (const auto& r : board.rows) appendBoardRow(out, '+', r);
+    return true;
+}
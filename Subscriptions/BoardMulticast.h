@@ -0,0 +1,62 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <map>
+#include <cstdint>
+#include <netinet/in.h>
+#include "../TrainManager/TrainManager.h"
+
+// Departure boards published on a multicast group (--multicast), so any
+// number of station displays cost one transmission. Each datagram is
+//
+//   [MCAST] <Epoch> <Seq>
+//   [BOARD] <Station> <HH:MM> [FULL]
+//   <rows as in BoardRegistry.h>
+//
+// and can be applied on its own: a board too large for one datagram is
+// split into a FULL datagram followed by '+' ones. Sequences count the
+// datagrams of each station, so a receiver that sees one missing stops
+// applying diffs until the next FULL (sent every few seconds), or asks for
+// BOARD_SNAPSHOT over TCP: same format, current sequence.
+//
+// refresh() and publishFull() run on the worker thread only.
+class BoardMulticast {
+private:
+    static const size_t MAX_DATAGRAM = 1400; // Within one Ethernet frame
+    static const int TTL = 1;                // Stays on the station LAN
+
+    struct Board {
+        std::vector<BoardRow> rows; // As last published
+        uint64_t seq = 0;           // Last datagram sent
+        int nowMin = 0;
+    };
+
+    int fd = -1;
+    sockaddr_in group{};
+    uint64_t epochID;
+    mutable std::mutex mtx;
+    std::map<std::string, Board> boards;
+
+    // Sends the lines under a "[BOARD]" header, as many datagrams as needed
+    void publish(const std::string& station, Board& board, const std::string& lines, bool full);
+
+public:
+    BoardMulticast();
+
+    // group is "<Address>:<Port>"; the stations are published from now on
+    bool start(const std::string& groupAddress, const std::vector<std::string>& stations);
+    bool running() const { return fd >= 0; }
+
+    // Published stations on this train's route (called from a delay listener)
+    void affectedStations(const Train& t, std::vector<std::string>& out) const;
+
+    // Sends the row diffs of the given boards (all when 'stations' is empty)
+    void refresh(TrainManager& tm, const std::vector<std::string>& stations);
+    // Sends every board in full, the resync point for receivers that lost datagrams
+    void publishFull(TrainManager& tm);
+
+    // BOARD_SNAPSHOT: the board with the sequence of the last datagram sent;
+    // false if the station is not published
+    bool snapshot(const std::string& station, std::string& out) const;
+};
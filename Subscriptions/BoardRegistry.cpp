@@ -0,0 +1,115 @@
+#include "BoardRegistry.h"
+#include "../TrainManager/TimeOfDay.h"
+
+using namespace std;
+
+static bool rowBefore(const BoardRow& a, const BoardRow& b) {
+    return a.trainID != b.trainID ? a.trainID < b.trainID : a.stopIndex < b.stopIndex;
+}
+
+void appendBoardRow(string& out, char op, const BoardRow& r) {
+    out += op;
+    out += ' ' + to_string(r.trainID) + ' ' + to_string(r.stopIndex);
+    if (op != '-') out += ' ' + timeofday::toTime(r.departure) + ' ' + to_string(r.delayMinutes) + ' ' + r.destination;
+    out += '\n';
+}
+
+// Both boards are in (train, stop) order, so one merge pass finds every change
+void diffBoardRows(const vector<BoardRow>& before, const vector<BoardRow>& after, string& out) {
+    size_t i = 0, j = 0;
+    while (i < before.size() || j < after.size()) {
+        if (j == after.size() || (i < before.size() && rowBefore(before[i], after[j]))) {
+            appendBoardRow(out, '-', before[i++]);
+        } else if (i == before.size() || rowBefore(after[j], before[i])) {
+            appendBoardRow(out, '+', after[j++]);
+        } else {
+            const BoardRow& a = before[i++];
+            const BoardRow& b = after[j++];
+            if (a.departure != b.departure || a.delayMinutes != b.delayMinutes || a.destination != b.destination) {
+                appendBoardRow(out, '~', b);
+            }
+        }
+    }
+}
+
+void BoardRegistry::subscribe(uint64_t connection, const string& station, TrainManager& tm, string& snapshot) {
+    // Read the timetable before taking our lock: delay listeners take them the other way round
+    vector<BoardRow> rows;
+    int nowMin = tm.getDepartureBoard(station, rows);
+
+    lock_guard<mutex> lock(mtx);
+    auto it = boards.find(station);
+    if (it == boards.end()) {
+        it = boards.emplace(station, Board()).first;
+        it->second.rows = move(rows);
+    }
+    // An existing board keeps its rows: the next diff is computed against them
+    Board& board = it->second;
+    if (board.clients.insert(connection).second) byClient[connection].push_back(station);
+
+    snapshot = "[BOARD] " + station + " " + timeofday::toTime(nowMin) + " FULL\n";
+    for (const auto& r : board.rows) appendBoardRow(snapshot, '+', r);
+}
+
+void BoardRegistry::removeClient(uint64_t connection) {
+    lock_guard<mutex> lock(mtx);
+    auto it = byClient.find(connection);
+    if (it == byClient.end()) return;
+
+    for (const auto& st : it->second) {
+        auto board = boards.find(st);
+        board->second.clients.erase(connection);
+        if (board->second.clients.empty()) boards.erase(board);
+    }
+    byClient.erase(it);
+}
+
+bool BoardRegistry::hasClient(uint64_t connection) const {
+    lock_guard<mutex> lock(mtx);
+    return byClient.count(connection) > 0;
+}
+
+bool BoardRegistry::empty() const {
+    lock_guard<mutex> lock(mtx);
+    return boards.empty();
+}
+
+void BoardRegistry::affectedStations(const Train& t, vector<string>& out) const {
+    lock_guard<mutex> lock(mtx);
+    if (boards.empty()) return;
+    for (const auto& s : t.route) {
+        if (boards.count(s.name)) out.push_back(s.name);
+    }
+}
+
+void BoardRegistry::refresh(TrainManager& tm, const vector<string>& stations,
+                            vector<pair<uint64_t, FramePtr>>& out) {
+    unordered_set<string> names;
+    {
+        lock_guard<mutex> lock(mtx);
+        if (stations.empty()) {
+            for (const auto& b : boards) names.insert(b.first);
+        } else {
+            for (const auto& st : stations) {
+                if (boards.count(st)) names.insert(st);
+            }
+        }
+    }
+
+    vector<BoardRow> rows;
+    for (const auto& station : names) {
+        int nowMin = tm.getDepartureBoard(station, rows);
+
+        lock_guard<mutex> lock(mtx);
+        auto it = boards.find(station);
+        if (it == boards.end()) continue; // Last display left meanwhile
+
+        string body;
+        diffBoardRows(it->second.rows, rows, body);
+        it->second.rows.swap(rows);
+        if (body.empty()) continue;
+
+        FramePtr frame = Frame::make("[BOARD] " + station + " " + timeofday::toTime(nowMin) + "\n" + body);
+        for (uint64_t connection : it->second.clients) out.emplace_back(connection, frame);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include "../TrainManager/TrainManager.h"
+#include "../Network/Outbox.h"
+
+// Departure boards followed by station displays (SUBSCRIBE_BOARD).
+// Each board keeps the rows its displays last received, so a refresh sends
+// only the rows that were inserted, changed or removed:
+//
+//   [BOARD] <Station> <HH:MM> [FULL]
+//   + <ID> <Stop> <HH:MM> <Delay> <Destination>    (new row)
+//   ~ <ID> <Stop> <HH:MM> <Delay> <Destination>    (changed row)
+//   - <ID> <Stop>                                  (removed row)
+//
+// FULL marks a snapshot that replaces the display's board.
+// subscribe() and refresh() run on the worker thread only, so displays see
+// the snapshot and the diffs that follow it in order.
+// Row lines of the format above (also used by the multicast feed)
+void appendBoardRow(std::string& out, char op, const BoardRow& r);
+// '+', '~' and '-' lines turning 'before' into 'after' (both in (train, stop) order)
+void diffBoardRows(const std::vector<BoardRow>& before, const std::vector<BoardRow>& after, std::string& out);
+
+class BoardRegistry {
+private:
+    struct Board {
+        std::vector<BoardRow> rows; // As last sent, in (train, stop) order
+        std::unordered_set<uint64_t> clients; // Connection ids
+    };
+
+    mutable std::mutex mtx;
+    std::unordered_map<std::string, Board> boards;
+    std::unordered_map<uint64_t, std::vector<std::string>> byClient;
+
+public:
+    // Adds the display and renders the FULL snapshot it starts from
+    void subscribe(uint64_t connection, const std::string& station, TrainManager& tm, std::string& snapshot);
+    void removeClient(uint64_t connection);
+    bool hasClient(uint64_t connection) const;
+    bool empty() const;
+
+    // Followed stations on this train's route (called from a delay listener)
+    void affectedStations(const Train& t, std::vector<std::string>& out) const;
+
+    // Re-reads the given boards (all when 'stations' is empty) and renders
+    // one diff frame per changed board, listed for each of its displays
+    void refresh(TrainManager& tm, const std::vector<std::string>& stations,
+                 std::vector<std::pair<uint64_t, FramePtr>>& out);
+};
@@ -0,0 +1,86 @@
+#include "SubscriptionRegistry.h"
+#include "../TrainManager/TimeOfDay.h"
+
+using namespace std;
+
+void SubscriptionRegistry::subscribeStation(uint64_t connection, const string& station) {
+    lock_guard<mutex> lock(mtx);
+    if (byStation[station].insert(connection).second) byClient[connection].stations.push_back(station);
+}
+
+void SubscriptionRegistry::subscribeTrain(uint64_t connection, int trainID) {
+    lock_guard<mutex> lock(mtx);
+    if (byTrain[trainID].insert(connection).second) byClient[connection].trains.push_back(trainID);
+}
+
+void SubscriptionRegistry::removeClient(uint64_t connection) {
+    lock_guard<mutex> lock(mtx);
+    auto it = byClient.find(connection);
+    if (it == byClient.end()) return;
+
+    for (const auto& st : it->second.stations) {
+        auto subs = byStation.find(st);
+        subs->second.erase(connection);
+        if (subs->second.empty()) byStation.erase(subs);
+    }
+    for (int id : it->second.trains) {
+        auto subs = byTrain.find(id);
+        subs->second.erase(connection);
+        if (subs->second.empty()) byTrain.erase(subs);
+    }
+    byClient.erase(it);
+}
+
+bool SubscriptionRegistry::hasClient(uint64_t connection) const {
+    lock_guard<mutex> lock(mtx);
+    return byClient.count(connection) > 0;
+}
+
+static string delayText(const Train& t) {
+    if (t.delayMinutes > 0) return "Delay " + to_string(t.delayMinutes) + " min";
+    if (t.delayMinutes < 0) return "Early by " + to_string(-t.delayMinutes) + " min";
+    return "On Time";
+}
+
+void SubscriptionRegistry::renderUpdate(const Train& t, vector<pair<uint64_t, FramePtr>>& out) const {
+    lock_guard<mutex> lock(mtx);
+    if (byClient.empty()) return;
+
+    // Each line is built once; then every recipient's lines are joined in order
+    vector<string> lines;
+    unordered_map<uint64_t, vector<uint32_t>> linesOf;
+    auto train = byTrain.find(t.trainID);
+    if (train != byTrain.end()) {
+        lines.push_back("[PUSH] Train " + to_string(t.trainID) + ": " + delayText(t) + " (" + t.estimate + ")\n");
+        for (uint64_t connection : train->second) linesOf[connection].push_back(0);
+    }
+
+    for (size_t i = 0; i < t.route.size(); ++i) {
+        const Station& s = t.route[i];
+        auto station = byStation.find(s.name);
+        if (station == byStation.end()) continue;
+
+        int arr = timeofday::toMinutes(s.arrivalTime);
+        int dep = timeofday::toMinutes(s.departureTime);
+        uint32_t line = lines.size();
+        lines.push_back("[PUSH] " + s.name + ": Train " + to_string(t.trainID)
+                    + " arr " + (arr < 0 ? string("-") : timeofday::toTime(arr + t.delayMinutes))
+                    + " dep " + (dep < 0 ? string("-") : timeofday::toTime(dep + t.delayMinutes))
+                    + " (" + delayText(t) + ")\n");
+        for (uint64_t connection : station->second) linesOf[connection].push_back(line);
+    }
+
+    vector<FramePtr> single(lines.size());
+    for (const auto& client : linesOf) {
+        const vector<uint32_t>& own = client.second;
+        if (own.size() == 1) {
+            FramePtr& frame = single[own[0]];
+            if (!frame) frame = Frame::make(lines[own[0]]);
+            out.emplace_back(client.first, frame);
+            continue;
+        }
+        string text;
+        for (uint32_t line : own) text += lines[line];
+        out.emplace_back(client.first, Frame::make(move(text)));
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include "../TrainManager/TrainManager.h"
+#include "../Network/Outbox.h"
+
+// Which clients follow which stations and trains, by connection id
+// (Outbox::connection(), never reused like a socket number).
+// Indexed both ways: by station/train to find the recipients of an update
+// (cost proportional to interested clients), and by client to drop
+// everything when it disconnects.
+class SubscriptionRegistry {
+private:
+    struct ClientSubs {
+        std::vector<std::string> stations;
+        std::vector<int> trains;
+    };
+
+    mutable std::mutex mtx;
+    std::unordered_map<std::string, std::unordered_set<uint64_t>> byStation;
+    std::unordered_map<int, std::unordered_set<uint64_t>> byTrain;
+    std::unordered_map<uint64_t, ClientSubs> byClient;
+
+public:
+    void subscribeStation(uint64_t connection, const std::string& station);
+    void subscribeTrain(uint64_t connection, int trainID);
+    void removeClient(uint64_t connection);
+    bool hasClient(uint64_t connection) const;
+
+    // Builds the push frame for every client affected by a delay on this
+    // train (train subscribers and subscribers of any station on its route).
+    // Each client gets one frame with all its lines; clients that match a
+    // single line share that line's frame.
+    void renderUpdate(const Train& t, std::vector<std::pair<uint64_t, FramePtr>>& out) const;
+};
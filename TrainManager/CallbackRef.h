@@ -0,0 +1,26 @@
+#pragma once
+#include <type_traits>
+#include <utility>
+
+// Non-owning reference to a callable, for the TrainManager visitors.
+// Unlike std::function it never allocates: it holds a pointer to the
+// caller's lambda, which only has to outlive the call it is passed to.
+template <typename Signature>
+class CallbackRef;
+
+template <typename R, typename... Args>
+class CallbackRef<R(Args...)> {
+private:
+    void* object;
+    R (*invoke)(void*, Args...);
+
+public:
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, CallbackRef>>>
+    CallbackRef(F&& f)
+        : object(const_cast<void*>(static_cast<const void*>(&f))),
+          invoke([](void* o, Args... args) -> R {
+              return (*static_cast<std::remove_reference_t<F>*>(o))(std::forward<Args>(args)...);
+          }) {}
+
+    R operator()(Args... args) const { return invoke(object, std::forward<Args>(args)...); }
+};
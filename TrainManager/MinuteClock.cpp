@@ -0,0 +1,68 @@
+#include "MinuteClock.h"
+#include <chrono>
+#include <ctime>
+
+using namespace std;
+
+int MinuteClock::wallMinute() {
+    time_t t = chrono::system_clock::to_time_t(chrono::system_clock::now());
+    tm lt;
+    localtime_r(&t, &lt);
+    return lt.tm_hour * 60 + lt.tm_min;
+}
+
+MinuteClock::~MinuteClock() {
+    {
+        lock_guard<mutex> lock(stateMtx);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (ticker.joinable()) ticker.join();
+}
+
+void MinuteClock::start() {
+    lock_guard<mutex> lock(stateMtx);
+    if (ticker.joinable() || stopping) return;
+    if (!simulated) minute = wallMinute();
+    ticker = thread(&MinuteClock::tick, this);
+}
+
+void MinuteClock::tick() {
+    unique_lock<mutex> lock(stateMtx);
+    while (true) {
+        auto next = chrono::floor<chrono::minutes>(chrono::system_clock::now()) + chrono::minutes(1);
+        if (wake.wait_until(lock, next, [this]() { return stopping; })) return;
+        if (simulated) continue;
+        // Read again rather than adding one: the process may have been
+        // suspended, or the local time may have changed (DST)
+        int m = wallMinute();
+        minute = m;
+        notify(m);
+    }
+}
+
+void MinuteClock::notify(int now) {
+    lock_guard<mutex> lock(listenerMtx);
+    for (const auto& listener : listeners) listener(now);
+}
+
+void MinuteClock::addListener(function<void(int)> listener) {
+    lock_guard<mutex> lock(listenerMtx);
+    listeners.push_back(move(listener));
+}
+
+void MinuteClock::set(int minuteOfDay) {
+    int m = (minuteOfDay % 1440 + 1440) % 1440;
+    lock_guard<mutex> lock(stateMtx);
+    simulated = true;
+    minute = m;
+    notify(m);
+}
+
+void MinuteClock::useWallClock() {
+    lock_guard<mutex> lock(stateMtx);
+    simulated = false;
+    int m = wallMinute();
+    minute = ticker.joinable() ? m : -1;
+    notify(m);
+}
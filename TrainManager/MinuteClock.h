@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <functional>
+
+// Current minute of the day (local time), the unit of every timetable query.
+// Queries read it with one atomic load; a ticker thread started by start()
+// updates it at each minute boundary and then calls the minute listeners
+// (board refreshes, stream updates), so the whole server moves to the new
+// minute together. The destructor stops and joins the ticker.
+//
+// set() replaces the wall clock with a fixed minute, for benchmarks and
+// reproducible runs (--clock): queries see that minute and the listeners
+// fire at once. Without start() or set(), now() reads the wall clock.
+class MinuteClock {
+private:
+    std::atomic<int> minute{-1};       // -1: not started, read the wall clock
+    std::atomic<bool> simulated{false};
+    // Serializes the ticker with set()/useWallClock(): a tick never stores
+    // the wall minute over a simulated one, and listeners see minutes in order
+    std::mutex stateMtx;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread ticker;
+    std::mutex listenerMtx;
+    std::vector<std::function<void(int)>> listeners;
+
+    void tick();
+    void notify(int now);
+
+public:
+    MinuteClock() = default;
+    MinuteClock(const MinuteClock&) = delete;
+    MinuteClock& operator=(const MinuteClock&) = delete;
+    ~MinuteClock();
+
+    // Minute of the day from the system clock
+    static int wallMinute();
+
+    int now() const {
+        int m = minute.load(std::memory_order_relaxed);
+        return m >= 0 ? m : wallMinute();
+    }
+
+    // Starts the ticker thread (once)
+    void start();
+
+    // Called from the ticker thread with the new minute; must be quick and
+    // must not call set() or useWallClock()
+    void addListener(std::function<void(int)> listener);
+
+    // Freezes the clock at this minute of the day and notifies the listeners
+    void set(int minuteOfDay);
+    // Back to the wall clock
+    void useWallClock();
+    bool isSimulated() const { return simulated.load(); }
+};
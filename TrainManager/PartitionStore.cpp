@@ -0,0 +1,151 @@
+#include "PartitionStore.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace tinyxml2;
+namespace fs = std::filesystem;
+
+// FNV-1a, enough to tell whether a partition file changed
+static uint64_t contentHash(const string& data) {
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : data) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static bool readFile(const string& path, string& out) {
+    ifstream in(path, ios::binary);
+    if (!in.is_open()) return false;
+    stringstream ss;
+    ss << in.rdbuf();
+    out = ss.str();
+    return true;
+}
+
+struct PendingPartition {
+    string file;
+    string content;
+    uint64_t hash;
+    shared_ptr<Partition> parsed;
+};
+
+bool PartitionStore::refresh(Timetable& merged, string& summary) {
+    // 1. Read and hash every partition file; keep the unchanged ones
+    map<string, shared_ptr<const Partition>> next;
+    vector<PendingPartition> changed;
+
+    error_code ec;
+    for (const auto& entry : fs::directory_iterator(directory, ec)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".xml") continue;
+
+        PendingPartition p;
+        p.file = entry.path().filename().string();
+        if (!readFile(entry.path().string(), p.content)) {
+            cerr << "[Partitions] Could not read " << entry.path() << endl;
+            continue;
+        }
+        p.hash = contentHash(p.content);
+
+        auto old = partitions.find(p.file);
+        if (old != partitions.end() && old->second->contentHash == p.hash) {
+            next[p.file] = old->second;
+        } else {
+            changed.push_back(move(p));
+        }
+    }
+    if (ec) {
+        cerr << "[Partitions] Could not list " << directory << ": " << ec.message() << endl;
+        return false;
+    }
+
+    // 2. Parse and index the changed partitions in parallel
+    atomic<size_t> nextIdx{0};
+    auto parseWorker = [&]() {
+        for (size_t i = nextIdx++; i < changed.size(); i = nextIdx++) {
+            PendingPartition& p = changed[i];
+            XMLDocument doc;
+            if (doc.Parse(p.content.data(), p.content.size()) != XML_SUCCESS) {
+                cerr << "[Partitions] XML error in " << p.file << ": " << doc.ErrorStr() << endl;
+                continue;
+            }
+            auto part = make_shared<Partition>();
+            part->file = p.file;
+            part->contentHash = p.hash;
+            if (!readTrainsFromXML(doc, part->data.trains)) continue;
+            part->data.buildIndexes();
+            p.parsed = part;
+        }
+    };
+    size_t threadCount = min<size_t>(changed.size(), max(1u, thread::hardware_concurrency()));
+    vector<thread> workers;
+    for (size_t i = 1; i < threadCount; ++i) workers.emplace_back(parseWorker);
+    parseWorker();
+    for (auto& w : workers) w.join();
+
+    size_t failed = 0;
+    for (auto& p : changed) {
+        if (p.parsed) {
+            next[p.file] = p.parsed;
+        } else {
+            // Keep serving the last good version of a broken partition
+            ++failed;
+            auto old = partitions.find(p.file);
+            if (old != partitions.end()) next[p.file] = old->second;
+        }
+    }
+    size_t removed = 0;
+    for (const auto& old : partitions) {
+        if (!next.count(old.first)) ++removed;
+    }
+    if (next.empty()) return false;
+    partitions = move(next);
+
+    // 3. Merge partitions; their station indexes are merged, not rebuilt,
+    // and their trains are copied without their routes (shared, see Route)
+    auto byTrain = [](const StopRef& a, const StopRef& b) {
+        return a.trainID != b.trainID ? a.trainID < b.trainID : a.stopIndex < b.stopIndex;
+    };
+    merged = Timetable();
+    for (const auto& pair : partitions) {
+        const Timetable& part = pair.second->data;
+        vector<int> skipped; // Sorted, trains come in ID order
+        for (const auto& t : part.trains) {
+            if (!merged.trains.emplace(t.first, t.second).second) {
+                cerr << "[Partitions] Train " << t.first << " in " << pair.first << " already loaded, skipped\n";
+                skipped.push_back(t.first);
+            }
+        }
+        for (const auto& st : part.stationIndex) {
+            auto& refs = merged.stationIndex[st.first];
+            size_t before = refs.size();
+            if (skipped.empty()) {
+                refs.insert(refs.end(), st.second.begin(), st.second.end());
+            } else {
+                for (const StopRef& ref : st.second) {
+                    if (!binary_search(skipped.begin(), skipped.end(), ref.trainID)) refs.push_back(ref);
+                }
+            }
+            // Both runs are in train ID order; keep it across partitions
+            if (before > 0 && before < refs.size() && byTrain(refs[before], refs[before - 1])) {
+                inplace_merge(refs.begin(), refs.begin() + before, refs.end(), byTrain);
+            }
+        }
+    }
+
+    stringstream ss;
+    ss << partitions.size() << " partitions, " << (changed.size() - failed) << " re-parsed";
+    if (failed) ss << ", " << failed << " failed";
+    if (removed) ss << ", " << removed << " removed";
+    summary = ss.str();
+    cout << "[Partitions] " << directory << ": " << summary << endl;
+    return true;
+}
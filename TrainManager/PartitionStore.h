@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <map>
+#include <memory>
+#include <cstdint>
+#include "TrainManager.h"
+
+// One timetable partition file (for example one line or region),
+// parsed and indexed on its own.
+struct Partition {
+    std::string file;
+    uint64_t contentHash;
+    Timetable data;
+};
+
+// Loads a directory of partition XML files in parallel and keeps the parsed
+// partitions between reloads. Only files whose content hash changed are
+// parsed and indexed again; the rest are reused as they are, and the
+// merged timetable shares their routes.
+class PartitionStore {
+private:
+    std::string directory;
+    std::map<std::string, std::shared_ptr<const Partition>> partitions; // By file name
+
+public:
+    explicit PartitionStore(std::string dir) : directory(std::move(dir)) {}
+
+    const std::string& dir() const { return directory; }
+
+    // Re-scans the directory and merges every partition into 'merged'.
+    // 'summary' describes what was re-parsed. Returns false if nothing was loaded.
+    bool refresh(Timetable& merged, std::string& summary);
+};
@@ -0,0 +1,139 @@
+#include "ScheduleWriter.h"
+#include "TrainManager.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+ScheduleWriter::ScheduleWriter() {
+    // Enough for a few hundred trains without growing
+    buffer.reserve(64 * 1024);
+}
+
+void ScheduleWriter::appendEscaped(string& out, const string& value) {
+    // Same entities tinyxml2 escapes inside attribute values
+    size_t start = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        const char* entity = nullptr;
+        switch (value[i]) {
+            case '"':  entity = "&quot;"; break;
+            case '&':  entity = "&amp;";  break;
+            case '\'': entity = "&apos;"; break;
+            case '<':  entity = "&lt;";   break;
+            case '>':  entity = "&gt;";   break;
+            default: continue;
+        }
+        out.append(value, start, i - start);
+        out.append(entity);
+        start = i + 1;
+    }
+    out.append(value, start, string::npos);
+}
+
+void ScheduleWriter::appendInt(string& out, int value) {
+    char digits[16];
+    auto res = to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, res.ptr - digits);
+}
+
+// Pads the value written since 'start' with spaces up to 'width' bytes.
+// Leading spaces keep the Delay readable as an int ("    10"),
+// trailing spaces are used for the Estimate text.
+void ScheduleWriter::appendPadded(string& out, size_t start, size_t width, bool alignRight) {
+    size_t len = out.size() - start;
+    if (len >= width) return;
+    if (alignRight) out.insert(start, width - len, ' ');
+    else out.append(width - len, ' ');
+}
+
+void ScheduleWriter::render(const map<int, Train>& trains, bool padded) {
+    buffer.clear(); // Keeps capacity
+    slots.clear();
+
+    buffer.append("<Trains>\n");
+    for (const auto& pair : trains) {
+        const Train& t = pair.second;
+        buffer.append("    <Train ID=\"");
+        appendInt(buffer, t.trainID);
+        buffer.append("\" Delay=\"");
+
+        if (padded) {
+            PatchSlot slot;
+            slot.trainID = t.trainID;
+            slot.delayOffset = buffer.size();
+            appendInt(buffer, t.delayMinutes);
+            appendPadded(buffer, slot.delayOffset, DELAY_WIDTH, true);
+            slot.delayWidth = buffer.size() - slot.delayOffset;
+            buffer.append("\" Estimate=\"");
+            slot.estimateOffset = buffer.size();
+            appendEscaped(buffer, t.estimate);
+            appendPadded(buffer, slot.estimateOffset, ESTIMATE_WIDTH, false);
+            slot.estimateWidth = buffer.size() - slot.estimateOffset;
+            slots.push_back(slot);
+        } else {
+            appendInt(buffer, t.delayMinutes);
+            buffer.append("\" Estimate=\"");
+            appendEscaped(buffer, t.estimate);
+        }
+        buffer.append("\">\n        <Route>\n");
+
+        for (const auto& s : t.route) {
+            buffer.append("            <Station Name=\"");
+            appendEscaped(buffer, s.name);
+            buffer.append("\" Arr=\"");
+            appendEscaped(buffer, s.arrivalTime);
+            buffer.append("\" Dep=\"");
+            appendEscaped(buffer, s.departureTime);
+            buffer.append("\"/>\n");
+        }
+        buffer.append("        </Route>\n    </Train>\n");
+    }
+    buffer.append("</Trains>\n");
+}
+
+const PatchSlot* ScheduleWriter::findSlot(int trainID) const {
+    auto it = lower_bound(slots.begin(), slots.end(), trainID,
+                          [](const PatchSlot& s, int id) { return s.trainID < id; });
+    if (it == slots.end() || it->trainID != trainID) return nullptr;
+    return &*it;
+}
+
+bool ScheduleWriter::renderPatch(const PatchSlot& slot, int delayMinutes, const string& estimate) {
+    patchBuffer.clear();
+
+    appendInt(patchBuffer, delayMinutes);
+    appendPadded(patchBuffer, 0, slot.delayWidth, true);
+    if (patchBuffer.size() != slot.delayWidth) return false;
+
+    patchBuffer.append("\" Estimate=\"");
+    size_t estStart = patchBuffer.size();
+    appendEscaped(patchBuffer, estimate);
+    appendPadded(patchBuffer, estStart, slot.estimateWidth, false);
+    if (patchBuffer.size() - estStart != slot.estimateWidth) return false;
+
+    return true;
+}
+
+bool ScheduleWriter::writeFile(const string& path) const {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("[Persistence] open failed");
+        return false;
+    }
+
+    size_t total = 0;
+    while (total < buffer.size()) {
+        ssize_t written = write(fd, buffer.data() + total, buffer.size() - total);
+        if (written <= 0) {
+            perror("[Persistence] write failed");
+            close(fd);
+            return false;
+        }
+        total += written;
+    }
+    close(fd);
+    return true;
+}
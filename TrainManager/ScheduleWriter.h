@@ -0,0 +1,56 @@
+#pragma once
+#include <string>
+#include <map>
+#include <vector>
+#include <sys/types.h>
+
+struct Train;
+
+// Where one train's Delay/Estimate values live inside the written file.
+// Only filled when rendering in padded (in-place patching) mode.
+struct PatchSlot {
+    int trainID;
+    off_t delayOffset;      // First byte of the Delay value (after the quote)
+    size_t delayWidth;
+    off_t estimateOffset;   // First byte of the Estimate value
+    size_t estimateWidth;
+};
+
+// Streams the <Trains> document straight into one reusable buffer.
+// The markup matches what tinyxml2's SaveFile used to print, so
+// loadDataFromXML reads it back unchanged.
+class ScheduleWriter {
+private:
+    std::string buffer; // Kept between saves, only grows when the schedule does
+    std::string patchBuffer;
+    std::vector<PatchSlot> slots; // Sorted by trainID (same order as the map)
+
+    static void appendEscaped(std::string& out, const std::string& value);
+    static void appendInt(std::string& out, int value);
+    static void appendPadded(std::string& out, size_t start, size_t width, bool alignRight);
+
+public:
+    // Fixed widths used in padded mode, wide enough for the usual values
+    static const size_t DELAY_WIDTH = 6;
+    static const size_t ESTIMATE_WIDTH = 32;
+
+    ScheduleWriter();
+
+    // Renders the whole schedule into the buffer (no file I/O).
+    // With padded = true, Delay and Estimate are written as fixed-width fields
+    // and their offsets are recorded so they can be patched later.
+    void render(const std::map<int, Train>& trains, bool padded = false);
+
+    // Slot recorded by the last padded render, or nullptr
+    const PatchSlot* findSlot(int trainID) const;
+
+    // Renders the bytes from a train's Delay value up to the end of its Estimate
+    // value into patchData(). Returns false if the new values do not fit the slot.
+    bool renderPatch(const PatchSlot& slot, int delayMinutes, const std::string& estimate);
+    const std::string& patchData() const { return patchBuffer; }
+
+    // Writes the rendered buffer to disk with a single write() in the common case
+    bool writeFile(const std::string& path) const;
+
+    const std::string& data() const { return buffer; }
+};
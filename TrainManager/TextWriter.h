@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <charconv>
+
+// Appends text responses to a buffer, numbers through std::to_chars, in
+// place of stringstream: no locale, no stream state, no temporary strings.
+// Reads like a stream:
+//
+//   TextWriter w(out);
+//   w << "Train " << id << " at ";
+//   w.time(minutes);
+class TextWriter {
+private:
+    std::string& out;
+
+public:
+    explicit TextWriter(std::string& buffer) : out(buffer) {}
+
+    TextWriter& operator<<(std::string_view s) { out.append(s); return *this; }
+    TextWriter& operator<<(const char* s) { out.append(s); return *this; }
+    TextWriter& operator<<(const std::string& s) { out.append(s); return *this; }
+    TextWriter& operator<<(char c) { out.push_back(c); return *this; }
+
+    TextWriter& operator<<(int v) {
+        char digits[12];
+        auto r = std::to_chars(digits, digits + sizeof(digits), v);
+        out.append(digits, r.ptr);
+        return *this;
+    }
+
+    // "HH:MM" of a minute of the day (wrapped into 0..1439), "--:--" if negative
+    TextWriter& time(int minutes) {
+        if (minutes < 0) return *this << "--:--";
+        minutes %= 1440;
+        char hhmm[5] = { char('0' + minutes / 600), char('0' + minutes / 60 % 10), ':',
+                         char('0' + minutes % 60 / 10), char('0' + minutes % 10) };
+        out.append(hhmm, sizeof(hhmm));
+        return *this;
+    }
+};
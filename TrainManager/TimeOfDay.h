@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <charconv>
+#include "TextWriter.h"
+
+// Times of the day as the timetable files write them ("HH:MM") and as the
+// queries compute with them (minutes since midnight)
+namespace timeofday {
+
+// "HH:MM" -> minutes of the day, -1 for "-" or anything unreadable
+inline int toMinutes(const std::string& time) {
+    if (time == "-" || time.empty()) return -1;
+    int h, m;
+    const char* end = time.data() + time.size();
+    auto r = std::from_chars(time.data(), end, h);
+    if (r.ec != std::errc() || r.ptr == end || *r.ptr != ':') return -1;
+    if (std::from_chars(r.ptr + 1, end, m).ec != std::errc()) return -1;
+    return (h * 60 + m) % 1440;
+}
+
+// Minutes of the day -> "HH:MM" ("--:--" for negative)
+inline std::string toTime(int minutes) {
+    std::string out; // "HH:MM" fits the small-string buffer
+    TextWriter(out).time(minutes);
+    return out;
+}
+
+} // namespace timeofday
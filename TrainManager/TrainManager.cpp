@@ -1,41 +1,20 @@
 #include "TrainManager.h"
+#include "PartitionStore.h"
+#include "TextWriter.h"
+#include "TimeOfDay.h"
+#include "../Gtfs/GtfsImporter.h"
 #include <sstream>
 #include <fstream> 
 #include <iostream>
 #include <chrono>
-#include <iomanip>
 #include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std;
 using namespace tinyxml2;
 
 // --- Time Helper Functions ---
-static int toMinutes(const string& time) {
-    if(time == "-" || time.empty()) return -1;
-    int h, m;
-    if (sscanf(time.c_str(), "%d:%d", &h, &m) != 2) return -1; 
-    return (h * 60 + m) % 1440;
-}
-
-static string toTime(int minutes) {
-    if(minutes < 0) return "--:--";
-    minutes = (minutes % 1440 + 1440) % 1440; 
-    int h = minutes / 60;
-    int m = minutes % 60;
-    stringstream ss;
-    ss << setw(2) << setfill('0') << h << ":" << setw(2) << setfill('0') << m;
-    return ss.str();
-}
-
-static string getCurrentTime() {
-    using namespace chrono;
-    auto now = system_clock::now();
-    time_t t = system_clock::to_time_t(now);
-    tm lt; localtime_r(&t, &lt); 
-    stringstream ss; ss << put_time(&lt, "%H:%M");
-    return ss.str();
-}
-
 static bool isTimeInNextHour(int targetTime, int nowTime) {
     if(targetTime == -1) return false;
     int oneHourLater = nowTime + 60;
@@ -64,28 +43,9 @@ void TrainManager::copyFile(const string& src, const string& dst) {
     cout << "[System] Schedule reset: " << dst << " was overwritten with data from " << src << ".\n";
 }
 
-void TrainManager::loadDataFromXML(const string& liveFile, const string& baseFile) {
-    lock_guard<mutex> lock(mtx);
-    trains.clear();
-    
-    dbFileName = liveFile;
-    masterFileName = baseFile;
-
-    // 1. Reset at start: Copy Base (org) over Live (mod)
-    // Thus, we delete old delays from the previous run
-    copyFile(masterFileName, dbFileName);
-
-    // 2. Load data from the Live file (now clean)
-    XMLDocument doc;
-    XMLError eResult = doc.LoadFile(dbFileName.c_str());
-    
-    if (eResult != XML_SUCCESS) {
-        cout << "[XML Error] XML read failure: " << dbFileName << endl;
-        return;
-    }
-
+bool readTrainsFromXML(XMLDocument& doc, map<int, Train>& trains, bool padded) {
     XMLElement* root = doc.FirstChildElement("Trains");
-    if (!root) return;
+    if (!root) return false;
 
     XMLElement* trainNode = root->FirstChildElement("Train");
     while (trainNode) {
@@ -94,6 +54,10 @@ void TrainManager::loadDataFromXML(const string& liveFile, const string& baseFil
         trainNode->QueryIntAttribute("Delay", &t.delayMinutes);
         const char* est = trainNode->Attribute("Estimate");
         t.estimate = est ? est : "N/A";
+        // Padded live files store the estimate with trailing spaces
+        if (padded) {
+            while (!t.estimate.empty() && t.estimate.back() == ' ') t.estimate.pop_back();
+        }
 
         XMLElement* routeNode = trainNode->FirstChildElement("Route");
         if (routeNode) {
@@ -112,56 +76,333 @@ void TrainManager::loadDataFromXML(const string& liveFile, const string& baseFil
         trains[t.trainID] = t;
         trainNode = trainNode->NextSiblingElement("Train");
     }
-    cout << "[XML] Data loaded successfully into memory.\n";
+    return true;
 }
 
-void TrainManager::saveDataToXML() {
+// Parses a schedule XML file into a train map
+static bool parseScheduleXML(const string& fileName, map<int, Train>& trains, bool padded) {
     XMLDocument doc;
-    XMLElement* root = doc.NewElement("Trains");
-    doc.InsertEndChild(root);
+    XMLError eResult = doc.LoadFile(fileName.c_str());
+    
+    if (eResult != XML_SUCCESS) {
+        cout << "[XML Error] XML read failure: " << fileName << endl;
+        return false;
+    }
+    return readTrainsFromXML(doc, trains, padded);
+}
 
+void Timetable::buildIndexes() {
+    stationIndex.clear();
     for (const auto& pair : trains) {
         const Train& t = pair.second;
-        XMLElement* trainNode = doc.NewElement("Train");
-        trainNode->SetAttribute("ID", t.trainID);
-        trainNode->SetAttribute("Delay", t.delayMinutes);
-        trainNode->SetAttribute("Estimate", t.estimate.c_str());
-
-        XMLElement* routeNode = doc.NewElement("Route");
-        for (const auto& s : t.route) {
-            XMLElement* stNode = doc.NewElement("Station");
-            stNode->SetAttribute("Name", s.name.c_str());
-            stNode->SetAttribute("Arr", s.arrivalTime.c_str());
-            stNode->SetAttribute("Dep", s.departureTime.c_str());
-            routeNode->InsertEndChild(stNode);
+        for (size_t i = 0; i < t.route.size(); ++i) {
+            stationIndex[t.route[i].name].push_back({ t.trainID, static_cast<int>(i) });
         }
-        trainNode->InsertEndChild(routeNode);
-        root->InsertEndChild(trainNode);
     }
-    // Save to the MODIFIABLE (live) file
-    doc.SaveFile(dbFileName.c_str());
-    cout << "[Persistence] Changes saved to " << dbFileName << endl;
 }
 
-void TrainManager::updateDelay(int trainID, int delayMinutes, const string& estimate) {
-    lock_guard<mutex> lock(mtx);
-    if(trains.count(trainID)) {
-        trains[trainID].delayMinutes = delayMinutes;
-        trains[trainID].estimate = estimate;
-        // Write to disk immediately
+void TrainManager::loadDataFromXML(const string& liveFile, const string& baseFile) {
+    lock_guard<shared_mutex> lock(mtx);
+    timetable = Timetable();
+    ++version;
+    
+    dbFileName = liveFile;
+    masterFileName = baseFile;
+    journal.openFile(dbFileName + ".journal");
+
+    // 1. Reset at start: Copy Base (org) over Live (mod)
+    // Thus, we delete old delays from the previous run
+    copyFile(masterFileName, dbFileName);
+
+    // 2. Load data from the Live file (now clean)
+    if (!parseScheduleXML(dbFileName, timetable.trains, patchInPlace)) return;
+    timetable.buildIndexes();
+    cout << "[XML] Data loaded successfully into memory.\n";
+
+    if (patchInPlace) {
+        // 3. Rewrite the live file with padded Delay/Estimate fields,
+        // recording their byte offsets for later in-place updates
         saveDataToXML();
+        openLiveFileForPatching();
     }
 }
 
-string TrainManager::getSchedule(const string& from, const string& to) {
-    lock_guard<mutex> lock(mtx);
+bool TrainManager::loadDataFromGTFS(const string& gtfsDir, const string& liveFile) {
+    lock_guard<shared_mutex> lock(mtx);
+    timetable = Timetable();
+    ++version;
+
+    dbFileName = liveFile;
+    masterFileName.clear();
+    journal.openFile(dbFileName + ".journal");
+    gtfsSource = gtfsDir;
+
+    GtfsImporter importer;
+    GtfsImportStats stats;
+    if (!importer.import(gtfsDir, timetable.trains, stats)) {
+        cout << "[GTFS Error] Import failed: " << gtfsDir << endl;
+        return false;
+    }
+    timetable.buildIndexes();
+
+    // The live file starts as the imported timetable in the native format
+    saveDataToXML();
+    if (patchInPlace) openLiveFileForPatching();
+    return true;
+}
+
+bool TrainManager::loadDataFromPartitions(const string& partitionDir, const string& liveFile) {
+    lock_guard<mutex> reloadLock(reloadMtx);
+    lock_guard<shared_mutex> lock(mtx);
+    timetable = Timetable();
+    ++version;
+
+    dbFileName = liveFile;
+    masterFileName.clear();
+    journal.openFile(dbFileName + ".journal");
+    partitionStore = make_unique<PartitionStore>(partitionDir);
+
+    string summary;
+    if (!partitionStore->refresh(timetable, summary)) {
+        cout << "[Partitions Error] No partition could be loaded from " << partitionDir << endl;
+        return false;
+    }
+
+    // The live file holds the merged timetable
+    saveDataToXML();
+    if (patchInPlace) openLiveFileForPatching();
+    return true;
+}
+
+// Builds a complete timetable from the base source (no lock held)
+bool TrainManager::buildTimetable(Timetable& fresh, string& summary) {
+    if (partitionStore) {
+        return partitionStore->refresh(fresh, summary);
+    }
+    if (!gtfsSource.empty()) {
+        GtfsImporter importer;
+        GtfsImportStats stats;
+        if (!importer.import(gtfsSource, fresh.trains, stats)) return false;
+    } else if (!parseScheduleXML(masterFileName, fresh.trains, patchInPlace)) {
+        return false;
+    }
+    fresh.buildIndexes();
+    return true;
+}
+
+// Copies the live delays of 'from' onto the same train IDs in 'to'. Trains
+// whose delay changed are added to 'changed'. Returns how many are delayed.
+static size_t carryDelays(const Timetable& from, Timetable& to, vector<int>& changed) {
+    size_t carried = 0;
+    for (auto& pair : to.trains) {
+        auto old = from.trains.find(pair.first);
+        if (old == from.trains.end()) continue;
+        Train& t = pair.second;
+        if (t.delayMinutes != old->second.delayMinutes || t.estimate != old->second.estimate) {
+            t.delayMinutes = old->second.delayMinutes;
+            t.estimate = old->second.estimate;
+            changed.push_back(t.trainID);
+        }
+        if (t.delayMinutes != 0) ++carried;
+    }
+    return carried;
+}
+
+string TrainManager::reloadTimetable() {
+    unique_lock<mutex> reloadLock(reloadMtx, try_to_lock);
+    if (!reloadLock.owns_lock()) return "ERROR: A reload is already in progress.\n";
+
+    auto start = chrono::steady_clock::now();
+    Timetable fresh;
+    string summary;
+    if (!buildTimetable(fresh, summary)) return "ERROR: Reload failed, keeping the current timetable.\n";
+
+    // The new live file is rendered with the current delays before the swap,
+    // without holding the lock
+    {
+        shared_lock<shared_mutex> lock(mtx);
+        vector<int> ignored;
+        carryDelays(timetable, fresh, ignored);
+    }
+    reloadWriter.render(fresh.trains, patchInPlace);
+
+    size_t carried = 0;
+    {
+        lock_guard<shared_mutex> lock(mtx);
+        // Delays reported during the render are carried again, and patched
+        // into the file once it is written
+        carried = carryDelays(timetable, fresh, unsavedTrains);
+        swap(timetable, fresh);
+        swap(writer, reloadWriter);
+        ++version;
+        liveFileRewriting = true;
+        for (const auto& listener : timetableListeners) listener(timetable);
+    }
+    // 'fresh' now holds the old version and is freed outside the lock
+
+    // Live file follows the new structure (and gets new patch offsets)
+    rewriteLiveFile();
+
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
     stringstream ss;
-    bool found = false;
+    ss << "OK: Timetable reloaded (" << fresh.trains.size() << " -> " << timetable.trains.size()
+       << " trains, " << carried << " delays carried over";
+    if (!summary.empty()) ss << ", " << summary;
+    ss << ") in " << ms << " ms.\n";
+    cout << "[Reload] " << ss.str();
+    return ss.str();
+}
+
+void TrainManager::openLiveFileForPatching() {
+    if (liveFd >= 0) close(liveFd);
+    liveFd = open(dbFileName.c_str(), O_WRONLY);
+    if (liveFd < 0) {
+        perror("[Persistence] Could not open live file for patching");
+        patchInPlace = false;
+    } else {
+        cout << "[Persistence] In-place patching enabled for " << dbFileName << ".\n";
+    }
+}
+
+TrainManager::TrainManager() = default;
+
+TrainManager::~TrainManager() {
+    if (liveFd >= 0) close(liveFd);
+}
+
+uint64_t TrainManager::timetableVersion() {
+    shared_lock<shared_mutex> lock(mtx);
+    return version;
+}
+
+void TrainManager::addTimetableListener(function<void(const Timetable&)> listener) {
+    lock_guard<shared_mutex> lock(mtx);
+    listener(timetable);
+    timetableListeners.push_back(move(listener));
+}
+
+uint64_t TrainManager::renderSnapshot(string& xml) {
+    // Own writer: the live file's one holds the patch offsets
+    ScheduleWriter snapshot;
+    shared_lock<shared_mutex> lock(mtx);
+    snapshot.render(timetable.trains);
+    xml = snapshot.data();
+    return version;
+}
+
+void TrainManager::saveDataToXML() {
+    // Stream the markup into the reusable buffer instead of building a DOM
+    writer.render(timetable.trains, patchInPlace);
+
+    // Save to the MODIFIABLE (live) file
+    if (writer.writeFile(dbFileName)) {
+        cout << "[Persistence] Changes saved to " << dbFileName << endl;
+    }
+}
+
+// Writes the live file rendered for a reload, without the lock: queries go
+// on meanwhile, and so do delays, which are held back from the file and
+// written on top of it afterwards. Nothing else uses the writer until then.
+void TrainManager::rewriteLiveFile() {
+    if (writer.writeFile(dbFileName)) {
+        cout << "[Persistence] Changes saved to " << dbFileName << endl;
+    }
 
-    if(from.empty() && to.empty()) ss << "--- Train Schedule (Complete) ---\n";
-    else ss << "--- Filtered Route: " << (from.empty()?"Any":from) << " -> " << (to.empty()?"Any":to) << " ---\n";
+    lock_guard<shared_mutex> lock(mtx);
+    liveFileRewriting = false;
+    vector<int> pending;
+    pending.swap(unsavedTrains);
+    if (!pending.empty()) saveTrainsLocked(pending);
+}
+
+// Overwrites only the Delay/Estimate bytes of one train in the live file.
+// Returns false when the slot is unknown or the new values do not fit,
+// in which case the caller falls back to a full save.
+bool TrainManager::patchTrainInFile(const Train& t) {
+    const PatchSlot* slot = writer.findSlot(t.trainID);
+    if (!slot || !writer.renderPatch(*slot, t.delayMinutes, t.estimate)) return false;
 
-    for(const auto &pair : trains) {
+    const string& bytes = writer.patchData();
+    ssize_t written = pwrite(liveFd, bytes.data(), bytes.size(), slot->delayOffset);
+    if (written != (ssize_t)bytes.size()) {
+        perror("[Persistence] pwrite failed");
+        return false;
+    }
+    cout << "[Persistence] Train " << t.trainID << " patched in place (" << bytes.size() << " bytes)\n";
+    return true;
+}
+
+// Applies one update to the timetable and journals it (lock held)
+bool TrainManager::applyDelayLocked(int trainID, int delayMinutes, const string& estimate) {
+    auto it = timetable.trains.find(trainID);
+    if(it == timetable.trains.end()) return false;
+    Train& t = it->second;
+    t.delayMinutes = delayMinutes;
+    t.estimate = estimate;
+    ++version;
+    journal.append(trainID, delayMinutes, estimate);
+    for (const auto& listener : delayListeners) listener(t);
+    return true;
+}
+
+// Writes the new Delay/Estimate of these trains to the live file (lock held)
+void TrainManager::saveTrainsLocked(const vector<int>& trainIDs) {
+    // Above this, one full save is cheaper than patching train by train
+    const size_t MAX_PATCHES = 64;
+
+    if (liveFileRewriting) {
+        unsavedTrains.insert(unsavedTrains.end(), trainIDs.begin(), trainIDs.end());
+        return;
+    }
+    if (patchInPlace && trainIDs.size() <= MAX_PATCHES) {
+        bool allPatched = true;
+        for (int id : trainIDs) {
+            auto it = timetable.trains.find(id);
+            if (it != timetable.trains.end() && !patchTrainInFile(it->second)) {
+                allPatched = false;
+                break;
+            }
+        }
+        if (allPatched) return;
+    }
+    saveDataToXML();
+}
+
+bool TrainManager::updateDelay(int trainID, int delayMinutes, const string& estimate) {
+    lock_guard<shared_mutex> lock(mtx);
+    if(!applyDelayLocked(trainID, delayMinutes, estimate)) return false;
+
+    // Write to disk immediately
+    saveTrainsLocked({ trainID });
+    return true;
+}
+
+size_t TrainManager::updateDelays(const vector<DelayEvent>& updates) {
+    lock_guard<shared_mutex> lock(mtx);
+    vector<int> applied;
+    for (const auto& u : updates) {
+        if (applyDelayLocked(u.trainID, u.delayMinutes, u.estimate)) applied.push_back(u.trainID);
+    }
+    if (applied.empty()) return 0;
+
+    saveTrainsLocked(applied);
+    return applied.size();
+}
+
+uint64_t TrainManager::snapshotDelays(vector<DelayEvent>& out) {
+    shared_lock<shared_mutex> lock(mtx);
+    out.reserve(out.size() + timetable.trains.size());
+    for (const auto& pair : timetable.trains) {
+        const Train& t = pair.second;
+        out.push_back({ 0, 0, t.trainID, t.delayMinutes, t.estimate });
+    }
+    // Journal appends happen under this lock, so the head matches the snapshot
+    return journal.head();
+}
+
+void TrainManager::visitScheduleLocked(const string& from, const string& to,
+                                       CallbackRef<void(const Train&, int, int)> visit) const {
+    for(const auto &pair : timetable.trains) {
         const Train& t = pair.second;
         int idxFrom = -1, idxTo = -1;
 
@@ -177,89 +418,258 @@ string TrainManager::getSchedule(const string& from, const string& to) {
                     (!from.empty() && to.empty() && idxFrom != -1) ||
                     (!from.empty() && !to.empty() && idxFrom != -1 && idxTo != -1 && idxFrom < idxTo);
 
-        if(show) {
-            int end = to.empty() ? t.route.size()-1 : idxTo;
-            ss << "Train " << t.trainID << ": " << t.route[idxFrom].name << "(" << t.route[idxFrom].departureTime << ") -> "
-               << t.route[end].name << "(" << t.route[end].arrivalTime << ")";
-            
-            if(t.delayMinutes > 0) ss << " [Delay " << t.delayMinutes << " min]";
-            else if(t.delayMinutes < 0) ss << " [Early by " << abs(t.delayMinutes) << " min]";
-            else ss << " [On Time]";
-            
-            ss << "\n";
-            found = true;
-        }
+        if(show) visit(t, idxFrom, to.empty() ? t.route.size()-1 : idxTo);
     }
-    if(!found) return "No trains found on this route.\n";
-    return ss.str();
 }
 
-string TrainManager::getDeparturesNextHour(const string& stationFilter) {
-    lock_guard<mutex> lock(mtx);
-    int nowMin = toMinutes(getCurrentTime());
-    stringstream ss;
-    ss << "Departures next hour (" << getCurrentTime() << "):\n";
-    
-    bool found = false;
-    for(const auto &pair : trains) {
-        const Train& t = pair.second;
-        for(size_t i=0; i<t.route.size()-1; ++i) {
-            if(!stationFilter.empty() && t.route[i].name != stationFilter) continue;
-            
-            int depPlan = toMinutes(t.route[i].departureTime);
-            int depReal = (depPlan + t.delayMinutes) % 1440;
-            
-            if(isTimeInNextHour(depReal, nowMin)) {
-                ss << "Train " << t.trainID << " from " << t.route[i].name << " at " << toTime(depReal);
-                if(t.delayMinutes != 0) ss << " (Delay: " << t.delayMinutes << ")";
-                ss << "\n";
-                found = true;
-            }
+void TrainManager::scheduleRowsLocked(const string& from, const string& to, vector<ScheduleRow>& rows) const {
+    rows.clear();
+    visitScheduleLocked(from, to, [&](const Train& t, int idxFrom, int end) {
+        rows.push_back({ t.trainID, t.delayMinutes,
+                         t.route[idxFrom].name, timeofday::toMinutes(t.route[idxFrom].departureTime),
+                         t.route[end].name, timeofday::toMinutes(t.route[end].arrivalTime) });
+    });
+}
+
+void TrainManager::getScheduleRows(const string& from, const string& to, vector<ScheduleRow>& rows) {
+    shared_lock<shared_mutex> lock(mtx);
+    scheduleRowsLocked(from, to, rows);
+}
+
+// Room for a typical line of the text responses, so the buffer is sized once
+static const size_t LINE_RESERVE = 72;
+
+// "HH:MM", or "-" where the stop has no such time
+static void writeStopTime(TextWriter& w, int minutes) {
+    if(minutes < 0) w << '-';
+    else w.time(minutes);
+}
+
+static string formatSchedule(const string& from, const string& to, const vector<ScheduleRow>& rows) {
+    if(rows.empty()) return "No trains found on this route.\n";
+
+    string out;
+    out.reserve((rows.size() + 1) * LINE_RESERVE);
+    TextWriter w(out);
+    if(from.empty() && to.empty()) w << "--- Train Schedule (Complete) ---\n";
+    else w << "--- Filtered Route: " << (from.empty() ? "Any" : from) << " -> " << (to.empty() ? "Any" : to) << " ---\n";
+
+    for(const auto& r : rows) {
+        w << "Train " << r.trainID << ": " << r.from << '(';
+        writeStopTime(w, r.departure);
+        w << ") -> " << r.to << '(';
+        writeStopTime(w, r.arrival);
+        w << ')';
+
+        if(r.delayMinutes > 0) w << " [Delay " << r.delayMinutes << " min]";
+        else if(r.delayMinutes < 0) w << " [Early by " << abs(r.delayMinutes) << " min]";
+        else w << " [On Time]";
+
+        w << '\n';
+    }
+    return out;
+}
+
+string TrainManager::getSchedule(const string& from, const string& to) {
+    vector<ScheduleRow> rows;
+    getScheduleRows(from, to, rows);
+    return formatSchedule(from, to, rows);
+}
+
+int TrainManager::visitStopEventsLocked(bool arrivals, const string& stationFilter,
+                                        CallbackRef<void(const Train&, int, int)> visit) const {
+    int nowMin = minuteClock.now();
+
+    auto check = [&](const Train& t, size_t i) {
+        // No arrival at the first station, no departure from the last one
+        if(arrivals ? i == 0 : i + 1 >= t.route.size()) return;
+
+        int plan = timeofday::toMinutes(arrivals ? t.route[i].arrivalTime : t.route[i].departureTime);
+        if(plan == -1) return;
+
+        int real = (plan + t.delayMinutes) % 1440;
+        if(real < 0) real += 1440;
+
+        if(isTimeInNextHour(real, nowMin)) visit(t, static_cast<int>(i), real);
+    };
+
+    if(stationFilter.empty()) {
+        for(const auto &pair : timetable.trains) {
+            for(size_t i=0; i<pair.second.route.size(); ++i) check(pair.second, i);
+        }
+    } else {
+        // Only the stops of this station, through the index
+        auto idx = timetable.stationIndex.find(stationFilter);
+        if(idx != timetable.stationIndex.end()) {
+            for(const StopRef& ref : idx->second) check(timetable.trains.at(ref.trainID), ref.stopIndex);
         }
     }
-    if(!found) return "No departures soon.\n";
-    return ss.str();
+    return nowMin;
+}
+
+int TrainManager::stopEventsLocked(bool arrivals, const string& stationFilter, vector<StopEvent>& rows) const {
+    rows.clear();
+    return visitStopEventsLocked(arrivals, stationFilter, [&](const Train& t, int i, int time) {
+        rows.push_back({ t.trainID, t.route[i].name, time, t.delayMinutes });
+    });
+}
+
+int TrainManager::getStopEvents(bool arrivals, const string& stationFilter, vector<StopEvent>& rows) {
+    shared_lock<shared_mutex> lock(mtx);
+    return stopEventsLocked(arrivals, stationFilter, rows);
+}
+
+static string formatDepartures(int nowMin, const vector<StopEvent>& rows) {
+    if(rows.empty()) return "No departures soon.\n";
+
+    string out;
+    out.reserve((rows.size() + 1) * LINE_RESERVE);
+    TextWriter w(out);
+    w << "Departures next hour (";
+    w.time(nowMin) << "):\n";
+    for(const auto& r : rows) {
+        w << "Train " << r.trainID << " from " << r.station << " at ";
+        w.time(r.time);
+        if(r.delayMinutes != 0) w << " (Delay: " << r.delayMinutes << ')';
+        w << '\n';
+    }
+    return out;
+}
+
+static string formatArrivals(int nowMin, const vector<StopEvent>& rows) {
+    if(rows.empty()) return "No arrivals soon.\n";
+
+    string out;
+    out.reserve((rows.size() + 1) * LINE_RESERVE);
+    TextWriter w(out);
+    w << "Arrivals next hour (";
+    w.time(nowMin) << "):\n";
+    for(const auto& r : rows) {
+        w << "Train " << r.trainID << " in " << r.station << " at ";
+        w.time(r.time);
+        if(r.delayMinutes < 0) w << " (EARLY " << abs(r.delayMinutes) << " min)";
+        else if(r.delayMinutes > 0) w << " (DELAY " << r.delayMinutes << " min)";
+        else w << " (On Time)";
+        w << '\n';
+    }
+    return out;
+}
+
+string TrainManager::getDeparturesNextHour(const string& stationFilter) {
+    vector<StopEvent> rows;
+    int nowMin = getStopEvents(false, stationFilter, rows);
+    return formatDepartures(nowMin, rows);
 }
 
 string TrainManager::getArrivalsNextHour(const string& stationFilter) {
-    lock_guard<mutex> lock(mtx);
-    int nowMin = toMinutes(getCurrentTime());
-    stringstream ss;
-    ss << "Arrivals next hour (" << getCurrentTime() << "):\n";
+    vector<StopEvent> rows;
+    int nowMin = getStopEvents(true, stationFilter, rows);
+    return formatArrivals(nowMin, rows);
+}
 
-    bool found = false;
-    for(const auto &pair : trains) {
-        const Train& t = pair.second;
-        for(size_t i=1; i<t.route.size(); ++i) {
-            if(!stationFilter.empty() && t.route[i].name != stationFilter) continue;
-
-            int arrPlan = toMinutes(t.route[i].arrivalTime);
-            if(arrPlan == -1) continue;
-            
-            int arrReal = (arrPlan + t.delayMinutes) % 1440;
-            if(arrReal < 0) arrReal += 1440;
-
-            if(isTimeInNextHour(arrReal, nowMin)) {
-                ss << "Train " << t.trainID << " in " << t.route[i].name << " at " << toTime(arrReal);
-                if(t.delayMinutes < 0) ss << " (EARLY " << abs(t.delayMinutes) << " min)";
-                else if(t.delayMinutes > 0) ss << " (DELAY " << t.delayMinutes << " min)";
-                else ss << " (On Time)";
-                ss << "\n";
-                found = true;
-            }
-        }
+int TrainManager::getDepartureBoard(const string& station, vector<BoardRow>& rows) {
+    shared_lock<shared_mutex> lock(mtx);
+    int nowMin = minuteClock.now();
+    rows.clear();
+
+    auto idx = timetable.stationIndex.find(station);
+    if(idx == timetable.stationIndex.end()) return nowMin;
+    for(const StopRef& ref : idx->second) {
+        const Train& t = timetable.trains.at(ref.trainID);
+        if(ref.stopIndex + 1 >= static_cast<int>(t.route.size())) continue;
+
+        int plan = timeofday::toMinutes(t.route[ref.stopIndex].departureTime);
+        if(plan == -1) continue; // No departure ("-")
+        int depReal = (plan + t.delayMinutes) % 1440;
+        if(depReal < 0) depReal += 1440;
+        if(!isTimeInNextHour(depReal, nowMin)) continue;
+        rows.push_back({ t.trainID, ref.stopIndex, depReal, t.delayMinutes, t.route.back().name });
     }
-    if(!found) return "No arrivals soon.\n";
-    return ss.str();
+    return nowMin;
 }
 
-string TrainManager::getTrainDetails(int id) {
-    lock_guard<mutex> lock(mtx);
-    if (trains.count(id)) {
-        Train& t = trains[id];
-        string res = "ID: " + to_string(t.trainID) + " | Status: " + t.estimate + " | Delay: " + to_string(t.delayMinutes) + "\nRoute:\n";
-        for (auto& s : t.route) res += " - " + s.name + " (Arr:" + s.arrivalTime + ", Dep:" + s.departureTime + ")\n";
+string TrainManager::trainDetailsLocked(int id) const {
+    auto it = timetable.trains.find(id);
+    if (it != timetable.trains.end()) {
+        const Train& t = it->second;
+        string res;
+        res.reserve((t.route.size() + 2) * LINE_RESERVE);
+        TextWriter w(res);
+        w << "ID: " << t.trainID << " | Status: " << t.estimate << " | Delay: " << t.delayMinutes << "\nRoute:\n";
+        for (const auto& s : t.route) w << " - " << s.name << " (Arr:" << s.arrivalTime << ", Dep:" << s.departureTime << ")\n";
         return res;
     }
     return "Train does not exist.\n";
+}
+
+string TrainManager::getTrainDetails(int id) {
+    shared_lock<shared_mutex> lock(mtx);
+    return trainDetailsLocked(id);
+}
+
+vector<string> TrainManager::runQueries(const vector<TimetableQuery>& queries) {
+    // Typed results are collected under one lock (one consistent view of the
+    // timetable), the text is formatted after it is released
+    struct Result {
+        int nowMin = 0;
+        vector<ScheduleRow> schedule;
+        vector<StopEvent> events;
+        string text;
+    };
+    vector<Result> results(queries.size());
+    {
+        shared_lock<shared_mutex> lock(mtx);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const TimetableQuery& q = queries[i];
+            Result& r = results[i];
+            switch (q.kind) {
+                case TimetableQuery::SCHEDULE:   scheduleRowsLocked(q.from, q.to, r.schedule); break;
+                case TimetableQuery::DEPARTURES: r.nowMin = stopEventsLocked(false, q.from, r.events); break;
+                case TimetableQuery::ARRIVALS:   r.nowMin = stopEventsLocked(true, q.from, r.events); break;
+                case TimetableQuery::TRAIN_INFO: r.text = trainDetailsLocked(q.trainID); break;
+            }
+        }
+    }
+
+    vector<string> out;
+    out.reserve(queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const TimetableQuery& q = queries[i];
+        Result& r = results[i];
+        switch (q.kind) {
+            case TimetableQuery::SCHEDULE:   out.push_back(formatSchedule(q.from, q.to, r.schedule)); break;
+            case TimetableQuery::DEPARTURES: out.push_back(formatDepartures(r.nowMin, r.events)); break;
+            case TimetableQuery::ARRIVALS:   out.push_back(formatArrivals(r.nowMin, r.events)); break;
+            case TimetableQuery::TRAIN_INFO: out.push_back(move(r.text)); break;
+        }
+    }
+    return out;
+}
+
+void TrainManager::forEachScheduleMatch(const string& from, const string& to,
+                                        CallbackRef<void(const Train&, int, int)> visit) {
+    shared_lock<shared_mutex> lock(mtx);
+    visitScheduleLocked(from, to, visit);
+}
+
+int TrainManager::forEachStopEvent(bool arrivals, const string& stationFilter,
+                                   CallbackRef<void(const Train&, int, int)> visit) {
+    shared_lock<shared_mutex> lock(mtx);
+    return visitStopEventsLocked(arrivals, stationFilter, visit);
+}
+
+bool TrainManager::withTrain(int id, CallbackRef<void(const Train&)> visit) {
+    shared_lock<shared_mutex> lock(mtx);
+    auto it = timetable.trains.find(id);
+    if (it == timetable.trains.end()) return false;
+    visit(it->second);
+    return true;
+}
+
+bool TrainManager::getTrain(int id, Train& out) {
+    shared_lock<shared_mutex> lock(mtx);
+    auto it = timetable.trains.find(id);
+    if (it == timetable.trains.end()) return false;
+    out = it->second;
+    return true;
 }
\ No newline at end of file
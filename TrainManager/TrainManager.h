@@ -2,8 +2,16 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <mutex>
+#include <shared_mutex>
+#include <memory>
+#include <functional>
 #include "../xml_parser/tinyxml2.h"
+#include "ScheduleWriter.h"
+#include "CallbackRef.h"
+#include "MinuteClock.h"
+#include "../Replication/DelayJournal.h"
 
 // Structure for a stop (station)
 struct Station {
@@ -12,32 +20,228 @@ struct Station {
     std::string departureTime; // ex: "10:15" or "-" for the last station
 };
 
+// The stops of a train. Copies of a train share one list: the stations
+// never change after loading, so merging partitions or carrying a train
+// into a new timetable does not copy them. push_back copies a shared list
+// first (the loaders build routes with it).
+class Route {
+private:
+    std::shared_ptr<std::vector<Station>> stops;
+
+    const std::vector<Station>& list() const {
+        static const std::vector<Station> none;
+        return stops ? *stops : none;
+    }
+    std::vector<Station>& own() {
+        if (!stops) stops = std::make_shared<std::vector<Station>>();
+        else if (stops.use_count() > 1) stops = std::make_shared<std::vector<Station>>(*stops);
+        return *stops;
+    }
+
+public:
+    size_t size() const { return list().size(); }
+    bool empty() const { return list().empty(); }
+    const Station& operator[](size_t i) const { return list()[i]; }
+    const Station& back() const { return list().back(); }
+    std::vector<Station>::const_iterator begin() const { return list().begin(); }
+    std::vector<Station>::const_iterator end() const { return list().end(); }
+
+    void reserve(size_t n) { own().reserve(n); }
+    void push_back(Station s) { own().push_back(std::move(s)); }
+};
+
 struct Train {
     int trainID;
-    std::vector<Station> route; 
+    Route route;
     int delayMinutes;
     std::string estimate;
 };
 
+// Position of one stop inside the timetable (train + index in its route)
+struct StopRef {
+    int trainID;
+    int stopIndex;
+};
+
+// One line of a station departure board, in the order of the station index
+// (train ID, then stop): (trainID, stopIndex) identifies the row
+struct BoardRow {
+    int trainID;
+    int stopIndex;
+    int departure;     // Real departure, minutes of the day
+    int delayMinutes;
+    std::string destination;
+};
+
+// One train of a GET_SCHEDULE result: boarding and leaving stop with planned times
+struct ScheduleRow {
+    int trainID;
+    int delayMinutes;
+    std::string from;
+    int departure;     // Minutes of the day, -1 if none
+    std::string to;
+    int arrival;
+};
+
+// A departure or arrival in the next hour, at its real (delayed) time
+struct StopEvent {
+    int trainID;
+    std::string station;
+    int time;          // Minutes of the day
+    int delayMinutes;
+};
+
+// One read-only query of a BATCH. 'from' is also the station filter of
+// DEPARTURES / ARRIVALS.
+struct TimetableQuery {
+    enum Kind { SCHEDULE, DEPARTURES, ARRIVALS, TRAIN_INFO } kind;
+    std::string from;
+    std::string to;
+    int trainID = 0;
+};
+
+// One complete version of the timetable plus the indexes built over it.
+// A reload builds a new one off to the side and swaps it in.
+struct Timetable {
+    std::map<int, Train> trains;
+    std::unordered_map<std::string, std::vector<StopRef>> stationIndex; // In train ID order
+
+    void buildIndexes();
+};
+
+// Reads the <Trains> document format shared by the base, live and partition files.
+// With padded = true, trailing spaces of Estimate are padding (--patch-in-place).
+bool readTrainsFromXML(tinyxml2::XMLDocument& doc, std::map<int, Train>& trains, bool padded = false);
+
+class PartitionStore;
+
 class TrainManager {
 private:
-    std::map<int, Train> trains;
-    std::mutex mtx;
+    Timetable timetable;
+    std::shared_mutex mtx;   // Shared by queries, exclusive for loads, reloads and delays
     std::string dbFileName;
     std::string masterFileName;
+    std::string gtfsSource;  // Set when the base timetable comes from a GTFS export
+    std::unique_ptr<PartitionStore> partitionStore; // Set when it comes from a partition directory
+    std::mutex reloadMtx;    // Only one reload builds (and writes the live file) at a time
+    DelayJournal journal;    // Every applied delay, in order (replication)
+    std::vector<std::function<void(const Train&)>> delayListeners;
+    std::vector<std::function<void(const Timetable&)>> timetableListeners;
+    ScheduleWriter writer; // Reused output buffer for saveDataToXML
+    ScheduleWriter reloadWriter; // A reload renders here, then swaps it with 'writer'
+    uint64_t version = 0;  // Bumped by every change to the timetable (loads, reloads, delays)
+    MinuteClock minuteClock; // "Now" of the next-hour queries
 
+    // In-place patching mode: the live file keeps Delay/Estimate in
+    // fixed-width fields, so an update only rewrites those bytes.
+    bool patchInPlace = false;
+    int liveFd = -1;
+
+    // While a reload rewrites the live file (without the lock), delays are
+    // applied in memory and their trains noted here, to be written after it
+    bool liveFileRewriting = false;
+    std::vector<int> unsavedTrains;
+
+    // Query bodies; the caller holds mtx
+    void visitScheduleLocked(const std::string& from, const std::string& to,
+                             CallbackRef<void(const Train&, int, int)> visit) const;
+    int visitStopEventsLocked(bool arrivals, const std::string& stationFilter,
+                              CallbackRef<void(const Train&, int, int)> visit) const;
+    void scheduleRowsLocked(const std::string& from, const std::string& to, std::vector<ScheduleRow>& rows) const;
+    int stopEventsLocked(bool arrivals, const std::string& stationFilter, std::vector<StopEvent>& rows) const;
+    std::string trainDetailsLocked(int id) const;
+
+    bool buildTimetable(Timetable& fresh, std::string& summary);
     void saveDataToXML();   
+    void rewriteLiveFile();
+    void openLiveFileForPatching();
+    bool patchTrainInFile(const Train& t);
+    void saveTrainsLocked(const std::vector<int>& trainIDs);
+    bool applyDelayLocked(int trainID, int delayMinutes, const std::string& estimate);
     void copyFile(const std::string& src, const std::string& dst);
 
 public:
+    TrainManager();
+    ~TrainManager();
+
+    // Must be called before loadDataFromXML
+    void setInPlacePatching(bool enabled) { patchInPlace = enabled; }
+
     void loadDataFromXML(const std::string& liveFile, const std::string& baseFile);
+
+    // Imports a GTFS-like export (stops.txt, trips.txt, stop_times.txt) as the base
+    // timetable and writes it to the live file in the native XML format
+    bool loadDataFromGTFS(const std::string& gtfsDir, const std::string& liveFile);
+
+    // Loads every *.xml partition in a directory (in parallel) and merges them.
+    // Reloads then only re-parse the partitions whose content changed.
+    bool loadDataFromPartitions(const std::string& partitionDir, const std::string& liveFile);
     
     std::string getSchedule(const std::string& from = "", const std::string& to = "");
     
     // These methods traverse the routes
     std::string getDeparturesNextHour(const std::string& stationFilter = "");
     std::string getArrivalsNextHour(const std::string& stationFilter = "");
+    // Typed departures of one station in the next hour; returns the current minute
+    int getDepartureBoard(const std::string& station, std::vector<BoardRow>& rows);
     std::string getTrainDetails(int id);
 
-    void updateDelay(int trainID, int delayMinutes, const std::string& estimate);
+    // Typed versions of the queries above (the text ones format these)
+    void getScheduleRows(const std::string& from, const std::string& to, std::vector<ScheduleRow>& rows);
+    // Departures (or arrivals) in the next hour; returns the current minute
+    int getStopEvents(bool arrivals, const std::string& stationFilter, std::vector<StopEvent>& rows);
+    bool getTrain(int id, Train& out);
+
+    // Allocation-free versions for programs embedding the engine (libtimetable):
+    // the callback sees the timetable's own Train, valid only during the call.
+    // Queries from any number of threads run at once; a callback must not call
+    // back into the TrainManager.
+    // Trains serving from -> to (either may be empty), with the stops' route indexes
+    void forEachScheduleMatch(const std::string& from, const std::string& to,
+                              CallbackRef<void(const Train&, int fromIndex, int toIndex)> visit);
+    // Stops departed from (or arrived at) in the next hour, with the real time in
+    // minutes of the day; returns the current minute
+    int forEachStopEvent(bool arrivals, const std::string& stationFilter,
+                         CallbackRef<void(const Train&, int stopIndex, int time)> visit);
+    bool withTrain(int id, CallbackRef<void(const Train&)> visit);
+
+    // Runs several queries against the same version of the timetable;
+    // returns the text response of each, in order
+    std::vector<std::string> runQueries(const std::vector<TimetableQuery>& queries);
+
+    // Returns false if the train does not exist
+    bool updateDelay(int trainID, int delayMinutes, const std::string& estimate);
+
+    // Applies several updates under one lock with a single save.
+    // Only trainID, delayMinutes and estimate are used. Returns how many applied.
+    size_t updateDelays(const std::vector<DelayEvent>& updates);
+
+    // Current delay of every train, and the journal sequence it corresponds to
+    uint64_t snapshotDelays(std::vector<DelayEvent>& out);
+
+    DelayJournal& delayJournal() { return journal; }
+
+    // The minute the departure and arrival queries count from (start() it, or set() it)
+    MinuteClock& clock() { return minuteClock; }
+
+    // Version of the timetable, and the whole timetable (with delays) rendered
+    // as schedule XML; renderSnapshot returns the version it rendered
+    uint64_t timetableVersion();
+    uint64_t renderSnapshot(std::string& xml);
+
+    // Called with the updated train after every applied delay, from the thread that
+    // applied it and with the lock held: listeners must be quick and must not call
+    // back into the TrainManager. Register them before serving clients.
+    void addDelayListener(std::function<void(const Train&)> listener) { delayListeners.push_back(std::move(listener)); }
+
+    // Called with the whole timetable at once, then after every reload swap; with
+    // the lock held, so calls are ordered with the delay listeners' ones
+    void addTimetableListener(std::function<void(const Timetable&)> listener);
+
+    // Re-reads the base timetable without stopping the server. The new version and
+    // its indexes are built by the calling thread without holding the lock, then
+    // swapped in with current delays carried over by train ID. The live file is
+    // rewritten after the lock is released.
+    // Returns a status line for the client.
+    std::string reloadTimetable();
 };
\ No newline at end of file
@@ -1,8 +1,15 @@
 #include <iostream>
 #include <sstream>
+#include <fstream>
 #include <cstring>
 #include <vector>
+#include <map>
+#include <algorithm>
 #include <cstdint>
+#include <chrono>
+#include "Protocol/FeedCodec.h"
+#include "Protocol/BinaryProtocol.h"
+#include "Protocol/Lz.h"
 
 #ifdef _WIN32
     // Windows
@@ -18,6 +25,10 @@
     #include <sys/socket.h>
     #include <unistd.h>
     #include <netinet/in.h>
+    #include <sys/un.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include "SharedMemory/ShmTimetable.h"
 #endif
 
 using namespace std;
@@ -32,8 +43,10 @@ string receiveAll(int sock) {
     
     if (bytes <= 0) return ""; // Server closed or error
 
-    // Convert from network format to host format
+    // Convert from network format to host format; the top bit marks a compressed frame
     uint32_t length = ntohl(networkLen); 
+    bool compressed = length & 0x80000000u;
+    length &= 0x7FFFFFFFu;
 
     // Allocate memory
     vector<char> buffer(length);
@@ -48,10 +61,449 @@ string receiveAll(int sock) {
         totalReceived += chunk;
     }
 
+    if (compressed) {
+        // Original size (4 bytes, big-endian), then the LZ block
+        if (length < 4) return "";
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(buffer.data());
+        size_t rawSize = (size_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+        string data;
+        if (!lz::decompress(buffer.data() + 4, length - 4, rawSize, data)) {
+            cerr << "Corrupt compressed frame.\n";
+            return "";
+        }
+        return data;
+    }
     return string(buffer.begin(), buffer.end());
 }
 
-int main() {
+#ifndef _WIN32
+// receiveAll for a frame that may carry a descriptor (SCM_RIGHTS). The
+// descriptor arrives with the first byte of the header, so the header is
+// read with recvmsg(); fd is -1 if there was none.
+string receiveWithFd(int sock, int& fd) {
+    fd = -1;
+    uint32_t networkLen;
+    iovec iov{ &networkLen, sizeof(networkLen) };
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(sock, &msg, MSG_WAITALL) != sizeof(networkLen)) return "";
+    for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS) memcpy(&fd, CMSG_DATA(cm), sizeof(int));
+    }
+
+    uint32_t length = ntohl(networkLen) & 0x7FFFFFFFu; // Frames with a descriptor are never compressed
+    string data(length, '\0');
+    size_t total = 0;
+    while (total < length) {
+        ssize_t chunk = recv(sock, &data[total], length - total, 0);
+        if (chunk <= 0) return "";
+        total += chunk;
+    }
+    return data;
+}
+#endif
+
+// FEED mode: prints every delay change pushed by the server until it disconnects
+void runFeed(int sock) {
+    FeedDecoder decoder;
+    FeedDecoder::Frame frame;
+    uint64_t epoch = 0, lastSeq = 0;
+
+    while (true) {
+        string data = receiveAll(sock);
+        if (data.empty() || !decoder.decode(data, frame)) {
+            cout << "Feed closed (epoch " << epoch << ", last seq " << lastSeq << ").\n";
+            return;
+        }
+        if (frame.type == 'S') {
+            epoch = frame.epoch;
+            lastSeq = frame.head;
+            cout << "[Snapshot @" << frame.head << "] " << frame.events.size() << " trains (epoch " << frame.epoch << ")\n";
+            for (const auto& e : frame.events) {
+                if (e.delayMinutes != 0) cout << "  Train " << e.trainID << ": " << e.delayMinutes << " min (" << e.estimate << ")\n";
+            }
+        } else if (frame.type == 'E') {
+            for (const auto& e : frame.events) {
+                cout << "[" << e.seq << "] Train " << e.trainID << ": " << e.delayMinutes << " min (" << e.estimate << ")\n";
+                lastSeq = e.seq;
+            }
+        }
+        cout.flush(); // Live output, even when piped
+    }
+}
+
+static bool sendFrame(int sock, const string& body) {
+    uint32_t length = htonl(body.size());
+    string frame(reinterpret_cast<const char*>(&length), sizeof(length));
+    frame += body;
+    return send(sock, frame.data(), static_cast<int>(frame.size()), 0) == static_cast<int>(frame.size());
+}
+
+static string minutesText(int minutes) {
+    if (minutes < 0) return "-";
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%02d:%02d", minutes / 60, minutes % 60);
+    return buf;
+}
+
+// Prints one binary response the same way the text protocol would show it
+void printBinaryResponse(BinaryDecoder& decoder, const string& data) {
+    WireReader r(data.data(), data.size());
+    BinaryDecoder::Header h;
+    if (!decoder.begin(r, h)) {
+        cout << "Malformed response.\n";
+        return;
+    }
+    if (h.status != BIN_OK) {
+        const char* reason = h.status == BIN_NOT_FOUND ? "not found"
+                           : h.status == BIN_READ_ONLY ? "read-only replica" : "bad request";
+        cout << "Error: " << reason << "\n";
+        return;
+    }
+
+    if (h.opcode == BIN_GET_SCHEDULE) {
+        uint64_t n = r.getVarint();
+        for (uint64_t i = 0; i < n && r.ok(); ++i) {
+            int id = r.getVarint();
+            int delay = r.getZigzag();
+            string from = decoder.station(r.getVarint());
+            int dep = getMinutes(r);
+            string to = decoder.station(r.getVarint());
+            int arr = getMinutes(r);
+            cout << "Train " << id << ": " << from << "(" << minutesText(dep) << ") -> " << to << "(" << minutesText(arr) << ")"
+                 << " [Delay " << delay << " min]\n";
+        }
+        if (n == 0) cout << "No trains found on this route.\n";
+    } else if (h.opcode == BIN_GET_DEPARTURES || h.opcode == BIN_GET_ARRIVALS) {
+        int now = getMinutes(r);
+        uint64_t n = r.getVarint();
+        cout << (h.opcode == BIN_GET_DEPARTURES ? "Departures" : "Arrivals") << " next hour (" << minutesText(now) << "):\n";
+        for (uint64_t i = 0; i < n && r.ok(); ++i) {
+            int id = r.getVarint();
+            string station = decoder.station(r.getVarint());
+            int time = getMinutes(r);
+            int delay = r.getZigzag();
+            cout << "Train " << id << " at " << station << " " << minutesText(time) << " (Delay: " << delay << ")\n";
+        }
+    } else if (h.opcode == BIN_GET_TRAIN_INFO) {
+        int id = r.getVarint();
+        int delay = r.getZigzag();
+        string estimate = r.getString8();
+        cout << "ID: " << id << " | Status: " << estimate << " | Delay: " << delay << "\nRoute:\n";
+        uint64_t n = r.getVarint();
+        for (uint64_t i = 0; i < n && r.ok(); ++i) {
+            string station = decoder.station(r.getVarint());
+            int arr = getMinutes(r);
+            int dep = getMinutes(r);
+            cout << " - " << station << " (Arr:" << minutesText(arr) << ", Dep:" << minutesText(dep) << ")\n";
+        }
+    } else if (h.opcode == BIN_REPORT_DELAY) {
+        cout << "OK: Delay updated!\n";
+    }
+    if (!r.ok()) cout << "Truncated response.\n";
+}
+
+// BINARY mode: the usual commands are typed as text, sent as binary requests
+void runBinary(int sock) {
+    BinaryDecoder decoder;
+    string input;
+    while (true) {
+        cout << "Enter command (binary): ";
+        if (!getline(cin, input) || input == "exit") return;
+
+        stringstream ss(input);
+        string keyword, a, b;
+        ss >> keyword;
+        string request;
+        WireWriter w(request);
+        if (keyword == "GET_SCHEDULE") {
+            ss >> a >> b;
+            w.put8(BIN_GET_SCHEDULE);
+            w.putString8(a);
+            w.putString8(b);
+        } else if (keyword == "GET_DEPARTURES" || keyword == "GET_ARRIVALS") {
+            ss >> a;
+            w.put8(keyword == "GET_DEPARTURES" ? BIN_GET_DEPARTURES : BIN_GET_ARRIVALS);
+            w.putString8(a);
+        } else if (keyword == "REPORT_DELAY") {
+            int id = 0, delay = 0;
+            if (!(ss >> id >> delay)) {
+                cout << "Use: REPORT_DELAY <ID> <Min> <Est>\n";
+                continue;
+            }
+            getline(ss >> ws, a);
+            w.put8(BIN_REPORT_DELAY);
+            w.putVarint(id);
+            w.putZigzag(delay);
+            w.putString8(a);
+        } else if (keyword == "GET_TRAIN_INFO") {
+            int id = 0;
+            ss >> id;
+            w.put8(BIN_GET_TRAIN_INFO);
+            w.putVarint(id);
+        } else {
+            cout << "Binary mode supports GET_SCHEDULE, GET_DEPARTURES, GET_ARRIVALS, REPORT_DELAY, GET_TRAIN_INFO and exit.\n";
+            continue;
+        }
+
+        if (!sendFrame(sock, request)) return;
+        string response = receiveAll(sock);
+        if (response.empty()) {
+            cout << "The server closed the connection.\n";
+            return;
+        }
+        cout << "--- Response from server (" << response.size() << " bytes) ---\n";
+        printBinaryResponse(decoder, response);
+    }
+}
+
+// Updates for SUBSCRIBE_STATION / SUBSCRIBE_TRAIN / SUBSCRIBE_BOARD can arrive at any time
+static bool isPush(const string& frame) {
+    return frame.compare(0, 6, "[PUSH]") == 0 || frame.compare(0, 7, "[BOARD]") == 0;
+}
+
+// --- DEPARTURE BOARD RENDERER ---
+
+struct BoardLine {
+    string time;
+    int delay;
+    string destination;
+};
+
+// Boards by station, rows by (train, stop) as sent by the server
+map<string, map<pair<int, int>, BoardLine>> displayBoards;
+
+static int minutesOf(const string& hhmm) {
+    return atoi(hhmm.c_str()) * 60 + atoi(hhmm.c_str() + 3);
+}
+
+// Applies a "[BOARD]" frame (FULL snapshot or row diffs) and redraws that board
+void applyBoardFrame(const string& frame) {
+    stringstream ss(frame);
+    string line, tag, station, now, full;
+    getline(ss, line);
+    stringstream header(line);
+    header >> tag >> station >> now >> full;
+
+    auto& rows = displayBoards[station];
+    if (full == "FULL") rows.clear();
+    while (getline(ss, line)) {
+        stringstream row(line);
+        char op;
+        pair<int, int> key;
+        if (!(row >> op >> key.first >> key.second)) continue;
+        if (op == '-') {
+            rows.erase(key);
+        } else {
+            BoardLine& b = rows[key];
+            row >> b.time >> b.delay >> b.destination;
+        }
+    }
+
+    // Departure order, counted from now so the board wraps past midnight
+    int nowMin = minutesOf(now);
+    vector<pair<int, const pair<const pair<int, int>, BoardLine>*>> order;
+    for (const auto& r : rows) order.emplace_back((minutesOf(r.second.time) - nowMin + 1440) % 1440, &r);
+    sort(order.begin(), order.end());
+
+    cout << "=== " << station << " departures (" << now << ") ===\n";
+    if (order.empty()) cout << "  No departures soon.\n";
+    for (const auto& o : order) {
+        const BoardLine& b = o.second->second;
+        cout << "  " << b.time << "  Train " << o.second->first.first << " to " << b.destination;
+        if (b.delay != 0) cout << "  (Delay: " << b.delay << ")";
+        cout << "\n";
+    }
+}
+
+static void showPush(const string& frame) {
+    if (frame.compare(0, 7, "[BOARD]") == 0) applyBoardFrame(frame);
+    else cout << frame;
+    cout.flush();
+}
+
+// --- MULTICAST BOARD RECEIVER ---
+
+// Splits "[MCAST] <Epoch> <Seq>\n<board frame>"; false if it is not one
+static bool parseMulticast(const string& data, unsigned long long& epoch, unsigned long long& seq, string& board) {
+    size_t nl = data.find('\n');
+    if (data.compare(0, 8, "[MCAST] ") != 0 || nl == string::npos) return false;
+    stringstream header(data.substr(8, nl - 8));
+    if (!(header >> epoch >> seq)) return false;
+    board = data.substr(nl + 1);
+    return board.compare(0, 7, "[BOARD]") == 0;
+}
+
+static bool boardHeader(const string& board, string& station) {
+    stringstream ss(board.substr(0, board.find('\n')));
+    string tag, now, full;
+    ss >> tag >> station >> now >> full;
+    return full == "FULL";
+}
+
+// The board as the server last published it, over the TCP connection
+static bool fetchSnapshot(int sock, const string& station, string& reply) {
+    string request = "BOARD_SNAPSHOT " + station;
+    if (send(sock, request.c_str(), static_cast<int>(request.size()), 0) < 0) return false;
+    do reply = receiveAll(sock); while (isPush(reply));
+    if (reply.compare(0, 7, "[MCAST]") == 0) return true;
+    cout << reply;
+    return false;
+}
+
+// BOARD_SNAPSHOT retries after a failure: from half a second, doubling up to 30 s
+class FetchBackoff {
+private:
+    chrono::steady_clock::time_point next;
+    int delayMs = 0;
+
+public:
+    bool ready() const { return delayMs == 0 || chrono::steady_clock::now() >= next; }
+    void succeeded() { delayMs = 0; }
+    void failed() {
+        delayMs = delayMs ? min(delayMs * 2, 30000) : 500;
+        next = chrono::steady_clock::now() + chrono::milliseconds(delayMs);
+    }
+};
+
+// MCAST_WATCH mode: follows one board on the server's multicast group.
+// A missing sequence number means lost datagrams: diffs are not applied
+// until the board is fetched again (BOARD_SNAPSHOT) or a FULL one arrives.
+// A failed fetch is retried on a later gap, after a growing pause.
+void runMulticast(int sock, const string& groupAddress, const string& station) {
+    size_t colon = groupAddress.find(':');
+    ip_mreq membership{};
+    if (colon == string::npos || inet_pton(AF_INET, groupAddress.substr(0, colon).c_str(), &membership.imr_multiaddr) != 1) {
+        cout << "Use: MCAST_WATCH <Group>:<Port> <Station>\n";
+        return;
+    }
+    membership.imr_interface.s_addr = htonl(INADDR_ANY);
+
+    int msock = socket(AF_INET, SOCK_DGRAM, 0);
+    int yes = 1;
+    // Several displays may run on the same machine
+    setsockopt(msock, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(atoi(groupAddress.c_str() + colon + 1));
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(msock, (sockaddr*)&local, sizeof(local)) < 0 ||
+        setsockopt(msock, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*)&membership, sizeof(membership)) < 0) {
+        cout << "Cannot join multicast group " << groupAddress << "\n";
+        close(msock);
+        return;
+    }
+    cout << "Following " << station << " on " << groupAddress << " (Ctrl+C to stop)...\n";
+
+    unsigned long long epoch = 0, seq = 0, lost = 0;
+    bool synced = false;
+    FetchBackoff fetch;
+    string data, board;
+
+    // Joined first, so nothing sent after the snapshot is missed
+    if (fetchSnapshot(sock, station, data) && parseMulticast(data, epoch, seq, board)) {
+        applyBoardFrame(board);
+        synced = true;
+    } else {
+        fetch.failed();
+        cout << "Waiting for the next full board...\n";
+    }
+    cout.flush();
+
+    vector<char> buffer(64 * 1024);
+    while (true) {
+        int n = recv(msock, buffer.data(), static_cast<int>(buffer.size()), 0);
+        if (n < 0) break;
+        unsigned long long e, s;
+        string name;
+        if (!parseMulticast(string(buffer.data(), n), e, s, board)) continue;
+        bool full = boardHeader(board, name);
+        if (name != station) continue;
+
+        if (synced && e == epoch && s <= seq) continue; // Already in the board (snapshot, duplicate)
+        if (!synced || e != epoch || s != seq + 1) {
+            if (synced) {
+                if (e == epoch) lost += s - seq - 1;
+                cout << "[Multicast] Lost datagrams after " << seq << " (got " << s << ", " << lost << " lost so far), resyncing\n";
+            }
+            synced = false;
+            if (!full) {
+                // The snapshot is at least as recent as this datagram
+                if (fetch.ready()) {
+                    if (fetchSnapshot(sock, station, data) && parseMulticast(data, epoch, seq, board)) {
+                        applyBoardFrame(board);
+                        synced = true;
+                        fetch.succeeded();
+                    } else {
+                        fetch.failed();
+                    }
+                }
+                cout.flush();
+                continue;
+            }
+        }
+        epoch = e;
+        seq = s;
+        synced = true;
+        applyBoardFrame(board);
+        cout.flush();
+    }
+    close(msock);
+}
+
+#ifndef _WIN32
+// SHM mode: answers from the server's shared-memory timetable (--shm),
+// then times the same lookup repeated many times
+void runShm(const string& segment, const string& query) {
+    ShmTimetable shm;
+    if (!shm.attach(segment)) {
+        cout << "Cannot map " << segment << " (is the server running with --shm?)\n";
+        return;
+    }
+    bool byID = !query.empty() && all_of(query.begin(), query.end(), ::isdigit);
+    int id = byID ? atoi(query.c_str()) : 0;
+    int nowMin = shm.currentMinute();
+    ShmTrainInfo train;
+    vector<ShmBoardRow> rows;
+
+    auto lookup = [&]() { return byID ? shm.getTrain(id, train) : shm.departureBoard(query, nowMin, rows); };
+    if (!lookup()) {
+        cout << (byID ? "Train " : "Station ") << query << " not found.\n";
+        return;
+    }
+    if (byID) {
+        cout << "Train " << train.trainID << " (delay " << train.delayMinutes << " min";
+        if (!train.estimate.empty()) cout << ", " << train.estimate;
+        cout << ")\n";
+        for (const auto& s : train.route) {
+            cout << "  " << s.station << "  " << minutesText(s.arrival) << " -> " << minutesText(s.departure) << "\n";
+        }
+    } else {
+        cout << "Departures from " << query << " after " << minutesText(nowMin) << ":\n";
+        for (const auto& r : rows) {
+            cout << "  " << minutesText(r.departure) << "  Train " << r.trainID << " to " << r.destination;
+            if (r.delayMinutes != 0) cout << " (+" << r.delayMinutes << ")";
+            cout << "\n";
+        }
+    }
+
+    const int rounds = 1000000;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) lookup();
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / rounds;
+    cout << rounds << " lookups: " << ns << " ns each (sequence " << shm.sequence() << ")\n";
+}
+#endif
+
+int main(int argc, char* argv[]) {
+    // Optional: ./client [ServerIP] [Port]
+    const char* serverIP = (argc > 1) ? argv[1] : "127.0.0.1";
+    int serverPort = (argc > 2) ? atoi(argv[2]) : 54000;
+
     #ifdef _WIN32
         WSADATA wsaData;
         if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
@@ -64,14 +516,26 @@ int main() {
     sockaddr_in serverAddr{};
 
     serverAddr.sin_family = AF_INET;
-    serverAddr.sin_port = htons(54000);
+    serverAddr.sin_port = htons(serverPort);
     //You can change the IP if needed into your own server ip
-    inet_pton(AF_INET,"127.0.0.1",&serverAddr.sin_addr);
+    inet_pton(AF_INET,serverIP,&serverAddr.sin_addr);
+
+    // A path instead of an IP: the server's Unix socket (--unix), for clients on the same host
+    #ifndef _WIN32
+    bool local = serverIP[0] == '/';
+    sockaddr_un localAddr{};
+    localAddr.sun_family = AF_UNIX;
+    strncpy(localAddr.sun_path, serverIP, sizeof(localAddr.sun_path) - 1);
+    #endif
 
     bool isConnected = false;
 
     for (int i = 0; i < MAX_RETRIES; ++i) {
+        #ifdef _WIN32
         sock = socket(AF_INET, SOCK_STREAM, 0);
+        #else
+        sock = socket(local ? AF_UNIX : AF_INET, SOCK_STREAM, 0);
+        #endif
         
         // Check socket validity (cross-platform compatible)
         #ifdef _WIN32
@@ -86,7 +550,13 @@ int main() {
 
         cout << "Connection attempt " << (i + 1) << "/" << MAX_RETRIES << "...\n";
 
-        if (connect(sock, (sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
+        #ifdef _WIN32
+        int result = connect(sock, (sockaddr*)&serverAddr, sizeof(serverAddr));
+        #else
+        int result = local ? connect(sock, (sockaddr*)&localAddr, sizeof(localAddr))
+                           : connect(sock, (sockaddr*)&serverAddr, sizeof(serverAddr));
+        #endif
+        if (result < 0) {
             close(sock); // On Windows this calls closesocket
             if (i < MAX_RETRIES - 1) {
                 sleep(WAIT_SECONDS); // On Windows this calls Sleep(2000)
@@ -116,11 +586,169 @@ int main() {
 
         if(input == "exit") break;
 
+        if(input.compare(0, 4, "FEED") == 0) {
+            // FEED [Epoch LastSeq]: resume where a previous feed stopped
+            // (without them, or after a server restart, it starts with a snapshot)
+            stringstream ss(input.substr(4));
+            unsigned long long epoch = 0, lastSeq = 0;
+            ss >> epoch >> lastSeq;
+            string request = "FEED " + to_string(epoch) + " " + to_string(lastSeq);
+            send(sock, request.c_str(), static_cast<int>(request.size()), 0);
+            runFeed(sock);
+            break;
+        }
+
+        if(input == "BINARY") {
+            send(sock, input.c_str(), static_cast<int>(input.size()), 0);
+            // Wait for the OK before the first binary frame
+            string reply = receiveAll(sock);
+            cout << reply;
+            if(reply.compare(0, 2, "OK") == 0) runBinary(sock);
+            break;
+        }
+
+        if(input.compare(0, 7, "INGEST ") == 0) {
+            // Streams a local file of <ID>,<Min>,<Estimate> lines, then shows the server's summary
+            ifstream file(input.substr(7), ios::binary);
+            if(!file.is_open()) {
+                cout << "Cannot open " << input.substr(7) << "\n";
+                continue;
+            }
+            string request = "INGEST";
+            send(sock, request.c_str(), static_cast<int>(request.size()), 0);
+            string reply = receiveAll(sock);
+            cout << reply;
+            if(reply.compare(0, 2, "OK") != 0) continue;
+
+            vector<char> chunk(64 * 1024);
+            while(file.read(chunk.data(), chunk.size()) || file.gcount() > 0) {
+                if(send(sock, chunk.data(), static_cast<int>(file.gcount()), 0) < 0) break;
+            }
+            shutdown(sock, 1); // No more data (SHUT_WR / SD_SEND)
+            cout << receiveAll(sock);
+            break;
+        }
+
+        if(input.compare(0, 12, "MCAST_WATCH ") == 0) {
+            // MCAST_WATCH <Group>:<Port> <Station>: a display fed by the multicast board feed
+            stringstream ss(input.substr(12));
+            string group, station;
+            if(!(ss >> group >> station)) {
+                cout << "Use: MCAST_WATCH <Group>:<Port> <Station>\n";
+                continue;
+            }
+            runMulticast(sock, group, station);
+            break;
+        }
+
+        if(input.compare(0, 6, "BENCH ") == 0) {
+            // BENCH <N> <Command>: round-trip latency of a command (compare TCP with --unix)
+            stringstream ss(input.substr(6));
+            int n = 0;
+            string command;
+            ss >> n;
+            getline(ss >> ws, command);
+            if(n <= 0 || command.empty()) {
+                cout << "Use: BENCH <N> <Command>\n";
+                continue;
+            }
+            vector<double> micros;
+            micros.reserve(n);
+            size_t bytes = 0;
+            for(int i = 0; i < n; ++i) {
+                auto start = chrono::steady_clock::now();
+                send(sock, command.c_str(), static_cast<int>(command.size()), 0);
+                string reply = receiveAll(sock);
+                micros.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+                if(reply.empty()) break;
+                bytes = reply.size();
+            }
+            sort(micros.begin(), micros.end());
+            double sum = 0;
+            for(double m : micros) sum += m;
+            cout << micros.size() << " x " << command << " (" << bytes << " byte reply): avg " << sum / micros.size()
+                 << " us, p50 " << micros[micros.size() / 2] << " us, p99 " << micros[micros.size() * 99 / 100]
+                 << " us, max " << micros.back() << " us\n";
+            continue;
+        }
+
+        #ifndef _WIN32
+        if(input.compare(0, 4, "SHM ") == 0) {
+            // SHM <Segment> <ID|Station>: same-host lookup in the server's shared memory, no request sent
+            stringstream ss(input.substr(4));
+            string segment, query;
+            ss >> segment;
+            getline(ss >> ws, query);
+            if(query.empty()) {
+                cout << "Use: SHM <Segment> <ID|Station>\n";
+                continue;
+            }
+            runShm(segment, query);
+            continue;
+        }
+
+        if(input.compare(0, 11, "SNAPSHOT_FD") == 0) {
+            // SNAPSHOT_FD [File]: the timetable arrives as a descriptor; read it (and save it if asked)
+            string path = input.size() > 12 ? input.substr(12) : "";
+            string request = "SNAPSHOT_FD";
+            send(sock, request.c_str(), static_cast<int>(request.size()), 0);
+            int fd;
+            string reply = receiveWithFd(sock, fd);
+            while(isPush(reply)) {
+                showPush(reply);
+                reply = receiveWithFd(sock, fd);
+            }
+            if(fd < 0) {
+                cout << reply;
+                if(reply.empty()) break;
+                continue;
+            }
+            struct stat st;
+            fstat(fd, &st);
+            void* data = st.st_size > 0 ? mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+            if(data != MAP_FAILED) {
+                string_view xml(static_cast<const char*>(data), st.st_size);
+                size_t trains = 0;
+                for(size_t pos = xml.find("<Train "); pos != string_view::npos; pos = xml.find("<Train ", pos + 1)) ++trains;
+                cout << reply << "Descriptor " << fd << ": " << st.st_size << " bytes mapped, " << trains << " trains.\n";
+                if(!path.empty()) {
+                    ofstream out(path, ios::binary);
+                    out.write(xml.data(), xml.size());
+                    cout << "Saved to " << path << "\n";
+                }
+                munmap(data, st.st_size);
+            }
+            close(fd);
+            continue;
+        }
+        #endif
+
+        if(input == "WATCH") {
+            // Print pushed updates until the server disconnects
+            cout << "Watching subscriptions (Ctrl+C to stop)...\n";
+            string push;
+            while(!(push = receiveAll(sock)).empty()) showPush(push);
+            cout << "The server closed the connection.\n";
+            break;
+        }
+
         // Send command (cast to const char* for maximum compatibility)
         send(sock, input.c_str(), static_cast<int>(input.size()), 0);
 
         cout << "--- Response from server ---\n";
         string response = receiveAll(sock);
+        // Pushes queued before the reply are shown as they come
+        bool boardReply = false;
+        while(isPush(response)) {
+            showPush(response);
+            // The reply to SUBSCRIBE_BOARD is the board snapshot itself
+            if(input.compare(0, 15, "SUBSCRIBE_BOARD") == 0 && response.find(" FULL\n") != string::npos) {
+                boardReply = true;
+                break;
+            }
+            response = receiveAll(sock);
+        }
+        if(boardReply) continue;
         
         if(response.empty()) {
             cout << "The server closed the connection.\n";
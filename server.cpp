@@ -4,31 +4,105 @@
 #include <cstring>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sys/un.h>
 #include <unistd.h>
 #include <signal.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <limits.h>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
 #include "TrainManager/TrainManager.h"
+#include "TrainManager/TimeOfDay.h"
 #include "Commands/Commandqueue.h"
+#include "Commands/RequestParser.h"
+#include "Gtfs/GtfsImporter.h"
+#include "Replication/Replicator.h"
+#include "Ingest/DelayIngest.h"
+#include "Ingest/UdpIngest.h"
+#include "Http/HttpGateway.h"
+#include "SharedMemory/ShmPublisher.h"
 
 using namespace std;
 
 CommandQueue commandQueue;
 TrainManager trainManager;
+Replicator replicator(trainManager);
+SubscriptionRegistry subscriptions;
+BoardRegistry boards;
+UdpIngest udpIngest(trainManager);
+BoardMulticast multicast;
+HttpGateway http(trainManager);
+SnapshotFile snapshotFile;
+ShmPublisher shmPublisher;
 
-bool sendToClient(int sock, const string& data) {
-    uint32_t length = htonl(data.size()); 
-    // Send Header (Length)
-    if (send(sock, &length, sizeof(length), 0) != sizeof(length)) return false;
+bool sendToClient(uint64_t connection, const string& data) {
+    return Command::sendAll(connection, data);
+}
+
+// Replies are sent without blocking, so a client thread waits here before
+// reading the next request: a client that does not read cannot make its
+// queue grow without bound
+static void waitForReader(uint64_t connection) {
+    if (auto box = Outbox::find(connection)) box->waitBacklog(Outbox::MAX_BACKLOG);
+}
 
-    // Send Body (Content)
+static bool receiveExact(int sock, char* data, size_t size) {
     size_t total = 0;
-    while(total < data.size()) {
-        ssize_t sent = send(sock, data.c_str() + total, data.size() - total, 0);
-        if(sent <= 0) return false;
-        total += sent;
+    while(total < size) {
+        ssize_t got = recv(sock, data + total, size - total, 0);
+        if(got <= 0) return false;
+        total += got;
     }
     return true;
 }
 
+// Binary mode: every request is a length-prefixed frame (see Protocol/BinaryProtocol.h)
+void serveBinary(int clientSocket, uint64_t connection) {
+    auto encoder = make_shared<BinaryEncoder>();
+    const uint32_t MAX_REQUEST = 4096;
+    while(true) {
+        waitForReader(connection);
+        uint32_t networkLen;
+        if(!receiveExact(clientSocket, reinterpret_cast<char*>(&networkLen), sizeof(networkLen))) return;
+        uint32_t length = ntohl(networkLen);
+        if(length == 0 || length > MAX_REQUEST) {
+            cerr << "[Client " << clientSocket << "] Bad binary frame length " << length << endl;
+            return;
+        }
+        string request(length, '\0');
+        if(!receiveExact(clientSocket, &request[0], length)) return;
+        commandQueue.push(make_unique<BinaryRequestCommand>(connection, encoder, move(request), replicator.isReplica()));
+    }
+}
+
+// INGEST mode: newline-delimited delay records until the client stops sending.
+// Records are applied in batches of up to MAX_BATCH, at the latest MAX_WAIT_MS
+// after they arrived (also when the client pauses).
+void ingestStream(int clientSocket, uint64_t connection) {
+    DelayIngest ingest(trainManager);
+    vector<char> buffer(64 * 1024);
+    while(true) {
+        int wait = ingest.msUntilDue();
+        if(wait >= 0) {
+            pollfd p{clientSocket, POLLIN, 0};
+            if(poll(&p, 1, wait) == 0) {
+                ingest.flush();
+                continue;
+            }
+        }
+        ssize_t n = recv(clientSocket, buffer.data(), buffer.size(), 0);
+        if(n <= 0) break;
+        ingest.feed(buffer.data(), n);
+        ingest.flushIfDue();
+    }
+    ingest.finish();
+    string summary = ingest.stats().summary();
+    cout << "[Ingest] Client " << clientSocket << ": " << summary << endl;
+    sendToClient(connection, "OK: " + summary + "\n");
+}
+
 // This thread runs infinitely and processes commands from the queue
 void processCommands() {
     cout << "[Worker] Thread started. Waiting for commands...\n";
@@ -37,87 +111,578 @@ void processCommands() {
         auto cmd = commandQueue.pop();
         
         // Execute command
-        if (cmd) {
-            cmd->execute(trainManager);
+        executeCommand(cmd, trainManager);
+    }
+}
+
+// Departure boards move with the clock: refresh them at every minute boundary
+// (called by the TrainManager's clock, after queries see the new minute)
+void minuteChanged(int) {
+    if (!boards.empty()) commandQueue.push(make_unique<BoardRefreshCommand>(boards, vector<string>()));
+    if (multicast.running()) commandQueue.push(make_unique<MulticastRefreshCommand>(multicast, vector<string>(), false));
+    http.minuteChanged();
+}
+
+// Multicast receivers that lost datagrams resync on the next full board
+void multicastTicker(int seconds) {
+    while (true) {
+        commandQueue.push(make_unique<MulticastRefreshCommand>(multicast, vector<string>(), true));
+        this_thread::sleep_for(chrono::seconds(seconds));
+    }
+}
+
+// Watches the base timetable and reloads it when the file is rewritten.
+// Editors often save through a temp file + rename, so the directory is watched.
+// For a partition directory, any *.xml file in it triggers the reload.
+void watchBaseFile(string path, bool isDirectory) {
+    size_t slash = path.find_last_of('/');
+    string dir = isDirectory ? path : (slash == string::npos) ? "." : path.substr(0, slash);
+    string name = isDirectory ? "" : (slash == string::npos) ? path : path.substr(slash + 1);
+
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        perror("[Watcher] inotify failed");
+        if (fd >= 0) close(fd);
+        return;
+    }
+    cout << "[Watcher] Watching " << path << " for changes.\n";
+
+    alignas(inotify_event) char buf[4096];
+    while (true) {
+        ssize_t len = read(fd, buf, sizeof(buf));
+        if (len <= 0) break;
+
+        bool changed = false;
+        for (char* p = buf; p < buf + len; ) {
+            auto* ev = reinterpret_cast<inotify_event*>(p);
+            if (ev->len > 0) {
+                string file = ev->name;
+                if (isDirectory ? (file.size() > 4 && file.compare(file.size() - 4, 4, ".xml") == 0)
+                                : file == name) changed = true;
+            }
+            p += sizeof(inotify_event) + ev->len;
+        }
+        if (changed) {
+            // Let the writer finish a burst of saves before reading
+            this_thread::sleep_for(chrono::milliseconds(200));
+            trainManager.reloadTimetable();
         }
     }
+    close(fd);
+}
+
+static bool isUnixSocket(int sock) {
+    sockaddr_storage addr{};
+    socklen_t len = sizeof(addr);
+    return getsockname(sock, (sockaddr*)&addr, &len) == 0 && addr.ss_family == AF_UNIX;
 }
 
 // CLIENT THREAD
-void handleClient(int clientSocket) {
-    char buffer[256];
-    while(true) {
-        memset(buffer, 0, sizeof(buffer));
+void handleClient(int clientSocket, uint64_t connection) {
+    char buffer[8192]; // Room for a BATCH of many queries
+    bool open = true;
+    while(open) {
+        waitForReader(connection);
         // Wait for data from client (blocking)
         int bytes = recv(clientSocket, buffer, sizeof(buffer), 0);
         if(bytes <= 0) break;
 
-        string request(buffer,bytes);
+        // Parsed in place (see Commands/RequestParser.h)
+        string_view request(buffer, bytes);
         // Clean newline at the end if it exists
-        if (!request.empty() && request.back() == '\n') request.pop_back();
-        if (!request.empty() && request.back() == '\r') request.pop_back();
+        if (!request.empty() && request.back() == '\n') request.remove_suffix(1);
+        if (!request.empty() && request.back() == '\r') request.remove_suffix(1);
 
-        stringstream ss(request);
-        string keyword;
-        ss >> keyword;
+        RequestTokens args(request);
+        string_view word = args.next();
+        Keyword keyword = lookupKeyword(word);
 
-        cout << "[Client " << clientSocket << "] Request: " << keyword << endl;
+        cout << "[Client " << clientSocket << "] Request: " << word << endl;
 
-        // Interpret command and push to QUEUE
-        if(keyword == "GET_SCHEDULE") {
-            string city1, city2;
-            ss >> city1 >> city2;
-            commandQueue.push(make_unique<GetScheduleCommand>(clientSocket, city1, city2));
+        bool writes = keyword == Keyword::REPORT_DELAY || keyword == Keyword::REPORT_DELAYS || keyword == Keyword::INGEST;
+        if(writes && replicator.isReplica()) {
+            string err = "ERROR: This server is a read-only replica. Report delays to the primary.\n";
+            sendToClient(connection, err);
+            continue;
         }
-        else if(keyword == "GET_DEPARTURES") {
-            string station;
-            // Read station if exists, otherwise send empty string
-            if(ss >> station) {
-                commandQueue.push(make_unique<GetDeparturesCommand>(clientSocket, station));
-            } else {
-                commandQueue.push(make_unique<GetDeparturesCommand>(clientSocket));
+
+        // Interpret command and push to QUEUE
+        switch(keyword) {
+            case Keyword::GET_SCHEDULE: {
+                string_view city1 = args.next(), city2 = args.next();
+                commandQueue.push(GetScheduleCommand(connection, string(city1), string(city2)));
+                break;
             }
-        }
-        else if(keyword == "GET_ARRIVALS") {
-            string station;
-            if(ss >> station) {
-                commandQueue.push(make_unique<GetArrivalsCommand>(clientSocket, station));
-            } else {
-                commandQueue.push(make_unique<GetArrivalsCommand>(clientSocket));
+            case Keyword::GET_DEPARTURES: {
+                // Read station if exists, otherwise send empty string
+                string_view station = args.next();
+                if(!station.empty()) {
+                    commandQueue.push(GetDeparturesCommand(connection, string(station)));
+                } else {
+                    commandQueue.push(GetDeparturesCommand(connection));
+                }
+                break;
+            }
+            case Keyword::GET_ARRIVALS: {
+                string_view station = args.next();
+                if(!station.empty()) {
+                    commandQueue.push(GetArrivalsCommand(connection, string(station)));
+                } else {
+                    commandQueue.push(GetArrivalsCommand(connection));
+                }
+                break;
+            }
+            case Keyword::REPORT_DELAY: {
+                int id, delay;
+                args.nextInt(id);
+                args.nextInt(delay);
+                commandQueue.push(ReportDelayCommand(connection, id, delay, string(args.next())));
+                break;
+            }
+            case Keyword::REPORT_DELAYS:
+                commandQueue.push(make_unique<ReportDelaysCommand>(connection, string(args.remainder())));
+                break;
+            case Keyword::INGEST:
+                sendToClient(connection, "OK: Send <ID>,<Min>,<Estimate> lines; shut down writing to finish.\n");
+                ingestStream(clientSocket, connection);
+                open = false;
+                break;
+            case Keyword::GET_TRAIN_INFO: {
+                int id;
+                if(args.nextInt(id)) {
+                    commandQueue.push(GetTrainInfoCommand(connection, id));
+                } else {
+                    string err = "Error: Use GET_TRAIN_INFO <ID>\n";
+                    sendToClient(connection, err);
+                }
+                break;
+            }
+            case Keyword::RELOAD:
+                commandQueue.push(make_unique<ReloadCommand>(connection, commandQueue));
+                break;
+            case Keyword::SUBSCRIBE_STATION: {
+                string_view station = args.next();
+                if(!station.empty()) {
+                    commandQueue.push(make_unique<SubscribeCommand>(connection, subscriptions, string(station)));
+                } else {
+                    string err = "Error: Use SUBSCRIBE_STATION <Station>\n";
+                    sendToClient(connection, err);
+                }
+                break;
+            }
+            case Keyword::SUBSCRIBE_TRAIN: {
+                int id;
+                if(args.nextInt(id)) {
+                    commandQueue.push(make_unique<SubscribeCommand>(connection, subscriptions, "", id));
+                } else {
+                    string err = "Error: Use SUBSCRIBE_TRAIN <ID>\n";
+                    sendToClient(connection, err);
+                }
+                break;
+            }
+            case Keyword::SUBSCRIBE_BOARD: {
+                string_view station = args.next();
+                if(!station.empty()) {
+                    commandQueue.push(make_unique<SubscribeBoardCommand>(connection, boards, string(station)));
+                } else {
+                    string err = "Error: Use SUBSCRIBE_BOARD <Station>\n";
+                    sendToClient(connection, err);
+                }
+                break;
+            }
+            case Keyword::BOARD_SNAPSHOT: {
+                string_view station = args.next();
+                if(!station.empty()) {
+                    commandQueue.push(make_unique<BoardSnapshotCommand>(connection, multicast, string(station)));
+                } else {
+                    string err = "Error: Use BOARD_SNAPSHOT <Station>\n";
+                    sendToClient(connection, err);
+                }
+                break;
+            }
+            case Keyword::UNSUBSCRIBE:
+                subscriptions.removeClient(connection);
+                boards.removeClient(connection);
+                sendToClient(connection, "OK: Unsubscribed.\n");
+                break;
+            case Keyword::BATCH:
+                commandQueue.push(make_unique<BatchCommand>(connection, string(args.remainder())));
+                break;
+            case Keyword::COMPRESS: {
+                string_view mode = args.next();
+                if(mode == "STATUS" || mode == "status") {
+                    sendToClient(connection, "OK: " + Frame::compressionStats() + "\n");
+                    break;
+                }
+                bool enabled = !(mode == "OFF" || mode == "off");
+                auto box = Outbox::find(connection);
+                if(box) box->setCompression(enabled);
+                sendToClient(connection, enabled ? "OK: Large responses will be compressed.\n" : "OK: Compression off.\n");
+                break;
+            }
+            case Keyword::BINARY: {
+                // Text pushes would corrupt the binary stream
+                subscriptions.removeClient(connection);
+                boards.removeClient(connection);
+                auto box = Outbox::find(connection);
+                if(box) box->switchToBinary();
+                sendToClient(connection, "OK: Binary protocol\n");
+                serveBinary(clientSocket, connection);
+                open = false;
+                break;
+            }
+            case Keyword::SNAPSHOT_FD:
+                if(isUnixSocket(clientSocket)) {
+                    commandQueue.push(make_unique<SnapshotFdCommand>(connection, snapshotFile));
+                } else {
+                    string err = "ERROR: SNAPSHOT_FD needs a Unix socket connection (--unix).\n";
+                    sendToClient(connection, err);
+                }
+                break;
+            case Keyword::UDP_STATUS:
+                commandQueue.push(make_unique<UdpStatusCommand>(connection, udpIngest));
+                break;
+            case Keyword::REPLICATION_STATUS:
+                commandQueue.push(make_unique<ReplicationStatusCommand>(connection, replicator));
+                break;
+            case Keyword::REPLICATE:
+            case Keyword::FEED: {
+                // This connection now only carries the change stream
+                uint64_t epoch = 0, lastSeq = 0;
+                args.nextUint64(epoch);
+                args.nextUint64(lastSeq);
+                replicator.serveStream(connection, epoch, lastSeq, keyword == Keyword::REPLICATE);
+                open = false;
+                break;
+            }
+            case Keyword::HELP:
+                commandQueue.push(HelpCommand(connection));
+                break;
+            default: {
+                string err="ERROR: Unknown command. Type 'help' for list.\n";
+                sendToClient(connection, err);
+                break;
             }
         }
-        else if(keyword == "REPORT_DELAY") {
-            int id, delay; string est;
-            ss >> id >> delay >> est;
-            commandQueue.push(make_unique<ReportDelayCommand>(clientSocket, id, delay, est));
+    }
+
+    subscriptions.removeClient(connection);
+    boards.removeClient(connection);
+    Outbox::release(connection);
+    close(clientSocket);
+    cout << "[Server] Client disconnected: " << clientSocket << endl;
+}
+
+// Local clients: same protocol as TCP, without the TCP/IP stack
+void acceptUnix(int listener, string path) {
+    cout << "[Server] Listening on " << path << "...\n";
+    while (true) {
+        int client = accept(listener, nullptr, nullptr);
+        if (client >= 0) {
+            cout << "[Server] New local client connected: " << client << endl;
+            uint64_t connection = Outbox::open(client)->connection();
+            thread(handleClient, client, connection).detach();
         }
-        else if(keyword=="GET_TRAIN_INFO"){
-            int id;
-            if(ss >> id) {
-                commandQueue.push(make_unique<GetTrainInfoCommand>(clientSocket, id));
-            } else {
-                string err = "Error: Use GET_TRAIN_INFO <ID>\n";
-                sendToClient(clientSocket, err);
+    }
+}
+
+static int listenUnix(const string& path) {
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        cerr << "[Server] Unix socket path too long: " << path << endl;
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    unlink(path.c_str()); // Left over by a previous run
+    if (fd < 0 || bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        perror("[Server] Unix socket failed");
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Offline benchmark of the in-process query API (--bench-queries), the way
+// a program linking libtimetable would use it: every thread runs train and
+// departure lookups for a second, first through the allocation-free
+// visitors, then through the text methods the server formats for clients
+static void benchQueries(int threads) {
+    vector<int> ids;
+    vector<string> stations;
+    trainManager.forEachScheduleMatch("", "", [&](const Train& t, int, int) {
+        ids.push_back(t.trainID);
+        for (const auto& s : t.route) stations.push_back(s.name);
+    });
+    sort(stations.begin(), stations.end());
+    stations.erase(unique(stations.begin(), stations.end()), stations.end());
+    if (ids.empty()) {
+        cerr << "[Bench] The timetable is empty\n";
+        return;
+    }
+
+    auto run = [&](const char* label, auto query) {
+        atomic<bool> stop{false};
+        atomic<uint64_t> total{0};
+        vector<thread> workers;
+        for (int w = 0; w < threads; ++w) {
+            workers.emplace_back([&, w]() {
+                uint64_t n = 0;
+                for (size_t i = w; !stop.load(memory_order_relaxed); ++i, n += 2) query(i);
+                total += n;
+            });
+        }
+        this_thread::sleep_for(chrono::seconds(1));
+        stop = true;
+        for (auto& w : workers) w.join();
+        cout << "[Bench] " << label << ": " << total.load() << " queries/s on " << threads << " threads\n";
+    };
+
+    atomic<long> sink{0};
+    run("Typed visitors", [&](size_t i) {
+        long sum = 0;
+        trainManager.withTrain(ids[i % ids.size()], [&](const Train& t) { sum += t.delayMinutes; });
+        trainManager.forEachStopEvent(false, stations[i % stations.size()], [&](const Train&, int, int time) { sum += time; });
+        sink.fetch_add(sum, memory_order_relaxed);
+    });
+    run("Text responses", [&](size_t i) {
+        size_t bytes = trainManager.getTrainDetails(ids[i % ids.size()]).size();
+        bytes += trainManager.getDeparturesNextHour(stations[i % stations.size()]).size();
+        sink.fetch_add(static_cast<long>(bytes), memory_order_relaxed);
+    });
+}
+
+// Offline benchmark of request parsing (--bench-parse): the in-place parser
+// of handleClient against the stringstream keyword extraction it replaced,
+// then the command queue with and without a heap allocation per command
+static void benchParse() {
+    const string_view requests[] = {
+        "GET_TRAIN_INFO 1661\n", "GET_SCHEDULE Iasi Bucuresti_Nord\n", "GET_DEPARTURES Roman\n",
+        "REPORT_DELAY 1661 10 Delayed\n", "SUBSCRIBE_BOARD Roman\n", "help\n",
+    };
+    const int rounds = 1000000;
+    long sink = 0;
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        RequestTokens args(requests[i % 6]);
+        Keyword keyword = lookupKeyword(args.next());
+        int id = 0;
+        if (keyword == Keyword::GET_TRAIN_INFO || keyword == Keyword::REPORT_DELAY) args.nextInt(id);
+        sink += static_cast<int>(keyword) + id + static_cast<long>(args.next().size());
+    }
+    double parsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / rounds;
+
+    const char* chain[] = { "GET_SCHEDULE", "GET_DEPARTURES", "GET_ARRIVALS", "REPORT_DELAY", "REPORT_DELAYS",
+                            "INGEST", "GET_TRAIN_INFO", "RELOAD", "SUBSCRIBE_STATION", "SUBSCRIBE_TRAIN",
+                            "SUBSCRIBE_BOARD", "BOARD_SNAPSHOT", "UNSUBSCRIBE", "BATCH", "COMPRESS", "BINARY",
+                            "SNAPSHOT_FD", "UDP_STATUS", "REPLICATION_STATUS", "REPLICATE", "FEED", "help" };
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        string request(requests[i % 6]);
+        request.pop_back();
+        stringstream ss(request);
+        string keyword, arg;
+        ss >> keyword;
+        int k = 0;
+        while (k < 22 && keyword != chain[k]) ++k;
+        int id = 0;
+        if (keyword == "GET_TRAIN_INFO" || keyword == "REPORT_DELAY") ss >> id;
+        ss >> arg;
+        sink += k + id + static_cast<long>(arg.size());
+    }
+    double streamed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / rounds;
+
+    cout << "[Bench] Request parsing: " << parsed << " ns in place, " << streamed
+         << " ns with stringstream (" << rounds << " requests, checksum " << sink << ")\n";
+
+    // Queue round trip of a command, stored inline versus allocated
+    CommandQueue queue;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        queue.push(GetTrainInfoCommand(0, i));
+        sink += static_cast<long>(queue.pop().index());
+    }
+    double inlined = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / rounds;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        queue.push(make_unique<ReloadCommand>(0, queue));
+        sink += static_cast<long>(queue.pop().index());
+    }
+    double boxed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / rounds;
+    cout << "[Bench] Queue push + pop: " << inlined << " ns inline, " << boxed << " ns with make_unique\n";
+}
+
+int main(int argc, char* argv[]) {
+    signal(SIGPIPE, SIG_IGN);
+
+    string gtfsDir;
+    string partitionDir;
+    string liveFile = "TrainSchedule/schedule_mod.xml";
+    string baseFile = "TrainSchedule/schedule_org.xml";
+    string primary;
+    string ingestFile;
+    int port = 54000;
+    int udpPort = 0;
+    int httpPort = 0;
+    string unixPath;
+    string shmName;
+    string multicastGroup;
+    vector<string> multicastBoards;
+    int multicastFull = 10;
+    bool watch = false;
+    int benchThreads = 0;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--patch-in-place") trainManager.setInPlacePatching(true);
+        else if (arg == "--watch") watch = true;
+        else if (arg == "--gtfs" && i + 1 < argc) gtfsDir = argv[++i];
+        else if (arg == "--partitions" && i + 1 < argc) partitionDir = argv[++i];
+        else if (arg == "--live" && i + 1 < argc) liveFile = argv[++i];
+        else if (arg == "--base" && i + 1 < argc) baseFile = argv[++i];
+        else if (arg == "--port" && i + 1 < argc) port = atoi(argv[++i]);
+        else if (arg == "--replica-of" && i + 1 < argc) primary = argv[++i];
+        else if (arg == "--ingest" && i + 1 < argc) ingestFile = argv[++i];
+        else if (arg == "--udp-port" && i + 1 < argc) udpPort = atoi(argv[++i]);
+        else if (arg == "--http-port" && i + 1 < argc) httpPort = atoi(argv[++i]);
+        else if (arg == "--unix" && i + 1 < argc) unixPath = argv[++i];
+        else if (arg == "--shm" && i + 1 < argc) shmName = argv[++i];
+        else if (arg == "--multicast" && i + 1 < argc) multicastGroup = argv[++i];
+        else if (arg == "--multicast-board" && i + 1 < argc) multicastBoards.push_back(argv[++i]);
+        else if (arg == "--multicast-full" && i + 1 < argc) multicastFull = max(1, atoi(argv[++i]));
+        else if (arg == "--bench-parse") {
+            benchParse();
+            return 0;
+        }
+        else if (arg == "--clock" && i + 1 < argc) {
+            // Simulated clock: queries and boards stay at this minute
+            int minute = timeofday::toMinutes(argv[++i]);
+            if (minute < 0) {
+                cerr << "Use --clock <HH:MM>\n";
+                return 1;
             }
+            trainManager.clock().set(minute);
         }
-        else if(keyword == "help") {
-            commandQueue.push(make_unique<HelpCommand>(clientSocket));
+        else if (arg == "--bench-queries" && i + 1 < argc) benchThreads = max(1, atoi(argv[++i]));
+        else if (arg == "--convert-gtfs" && i + 2 < argc) {
+            // Offline converter: GTFS directory -> native schedule XML, then exit
+            map<int, Train> trains;
+            GtfsImporter importer;
+            GtfsImportStats stats;
+            if (!importer.import(argv[i + 1], trains, stats)) return 1;
+            ScheduleWriter writer;
+            writer.render(trains);
+            if (!writer.writeFile(argv[i + 2])) return 1;
+            cout << "[GTFS] Wrote " << trains.size() << " trains to " << argv[i + 2] << endl;
+            return 0;
         }
         else {
-            string err="ERROR: Unknown command. Type 'help' for list.\n";
-            sendToClient(clientSocket, err);
+            cerr << "Unknown option: " << arg << endl;
+            return 1;
         }
     }
 
-    close(clientSocket);
-    cout << "[Server] Client disconnected: " << clientSocket << endl;
-}
+    // One base timetable source; --watch follows the XML file or the partition directory
+    if (!gtfsDir.empty() && !partitionDir.empty()) {
+        cerr << "Use either --gtfs or --partitions, not both\n";
+        return 1;
+    }
+    if (watch && !gtfsDir.empty()) {
+        cerr << "--watch cannot follow a GTFS export; send RELOAD after updating it\n";
+        return 1;
+    }
 
-int main() {
-    signal(SIGPIPE, SIG_IGN);
     // Load data (Now using the vector function)
     // Note: Folder names translated to English
-    trainManager.loadDataFromXML("TrainSchedule/schedule_mod.xml", "TrainSchedule/schedule_org.xml");
+    if (!gtfsDir.empty()) {
+        if (!trainManager.loadDataFromGTFS(gtfsDir, liveFile)) return 1;
+    } else if (!partitionDir.empty()) {
+        if (!trainManager.loadDataFromPartitions(partitionDir, liveFile)) return 1;
+    } else {
+        trainManager.loadDataFromXML(liveFile, baseFile);
+    }
+
+    if (!ingestFile.empty()) {
+        // Replays a file of delay records on top of the loaded timetable
+        IngestStats stats;
+        if (!DelayIngest::ingestFile(trainManager, ingestFile, stats)) return 1;
+        cout << "[Ingest] " << ingestFile << ": " << stats.summary() << endl;
+    }
+
+    if (benchThreads > 0) {
+        trainManager.clock().start();
+        benchQueries(benchThreads);
+        return 0;
+    }
+
+    if (watch && !partitionDir.empty()) {
+        thread(watchBaseFile, partitionDir, true).detach();
+    } else if (watch) {
+        thread(watchBaseFile, baseFile, false).detach();
+    }
+
+    if (!primary.empty()) {
+        // Read-only replica: delays come from the primary's journal
+        size_t colon = primary.find(':');
+        string host = primary.substr(0, colon);
+        int primaryPort = (colon == string::npos) ? 54000 : atoi(primary.c_str() + colon + 1);
+        replicator.startReplica(host, primaryPort);
+    }
+
+    if (udpPort > 0) {
+        if (!primary.empty()) {
+            cerr << "[UDP] A replica does not accept delay reports; --udp-port ignored\n";
+        } else if (!udpIngest.start(udpPort)) {
+            return 1;
+        }
+    }
+
+    if (httpPort > 0 && !http.start(httpPort)) return 1;
+
+    if (!unixPath.empty()) {
+        int listener = listenUnix(unixPath);
+        if (listener < 0) return 1;
+        thread(acceptUnix, listener, unixPath).detach();
+    }
+
+    if (!multicastGroup.empty()) {
+        if (multicastBoards.empty()) {
+            cerr << "[Multicast] Name the published stations with --multicast-board <Station>\n";
+            return 1;
+        }
+        if (!multicast.start(multicastGroup, multicastBoards)) return 1;
+        thread(multicastTicker, multicastFull).detach();
+    }
+
+    // Push delay updates to subscribed clients (sent by the worker thread)
+    trainManager.addDelayListener([](const Train& t) {
+        vector<pair<uint64_t, FramePtr>> messages;
+        subscriptions.renderUpdate(t, messages);
+        if (!messages.empty()) commandQueue.push(make_unique<PushUpdateCommand>(subscriptions, move(messages)));
+
+        vector<string> stations;
+        boards.affectedStations(t, stations);
+        if (!stations.empty()) commandQueue.push(make_unique<BoardRefreshCommand>(boards, move(stations)));
+
+        vector<string> published;
+        multicast.affectedStations(t, published);
+        if (!published.empty()) commandQueue.push(make_unique<MulticastRefreshCommand>(multicast, move(published), false));
+
+        http.trainChanged(t);
+    });
+
+    if (!shmName.empty()) {
+        // Same-host readers map the timetable (SharedMemory/ShmTimetable.h)
+        if (!shmPublisher.open(shmName)) return 1;
+        trainManager.addTimetableListener([](const Timetable& t) { shmPublisher.publish(t); });
+        trainManager.addDelayListener([](const Train& t) { shmPublisher.trainChanged(t); });
+        shmPublisher.setMinute(trainManager.clock().now());
+        trainManager.clock().addListener([](int now) { shmPublisher.setMinute(now); });
+    }
+    trainManager.clock().addListener(minuteChanged);
+    trainManager.clock().start();
 
     // Start Worker Thread that will consume commands
     thread worker(processCommands);
@@ -127,7 +692,7 @@ int main() {
     int serverSocket = socket(AF_INET, SOCK_STREAM, 0);
     sockaddr_in addr{};
     addr.sin_family = AF_INET;
-    addr.sin_port = htons(54000);
+    addr.sin_port = htons(port);
     addr.sin_addr.s_addr = INADDR_ANY;
 
     int opt = 1;
@@ -139,7 +704,7 @@ int main() {
     }
     
     listen(serverSocket, 5);
-    cout << "[Server] Listening on port 54000...\n";
+    cout << "[Server] Listening on port " << port << "...\n";
 
     // Accepting new clients
     while(true) {
@@ -149,8 +714,9 @@ int main() {
         
         if (client >= 0) {
             cout << "[Server] New client connected: " << client << endl;
+            uint64_t connection = Outbox::open(client)->connection();
             // For each client, start a dedicated reading thread
-            thread(handleClient, client).detach();
+            thread(handleClient, client, connection).detach();
         }
     }
 